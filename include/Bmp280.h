@@ -0,0 +1,101 @@
+#ifndef Bmp280_h
+#define Bmp280_h
+
+#include <Arduino.h>
+
+// Oversampling settings (osrs_x fields)
+#define BMP280_OSRS_SKIP 0
+#define BMP280_OSRS_X1 1
+#define BMP280_OSRS_X2 2
+#define BMP280_OSRS_X4 3
+#define BMP280_OSRS_X8 4
+#define BMP280_OSRS_X16 5
+
+// IIR filter coefficients (config.filter field)
+#define BMP280_FILTER_OFF 0
+#define BMP280_FILTER_2 1
+#define BMP280_FILTER_4 2
+#define BMP280_FILTER_8 3
+#define BMP280_FILTER_16 4
+
+#define BMP280_CHIP_ID 0x58
+#define BME280_CHIP_ID 0x60
+
+/*
+    Register access used by the driver. The firmware uses WireBmp280Bus;
+    the native tests use FakeBmp280Bus (test/host), which serves a
+    register map.
+*/
+class Bmp280Bus
+{
+public:
+    virtual bool writeRegister(uint8_t addr, uint8_t reg, uint8_t value) = 0;
+    virtual bool readRegisters(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len) = 0;
+};
+
+#ifdef ARDUINO
+class WireBmp280Bus : public Bmp280Bus
+{
+public:
+    void begin();
+    bool writeRegister(uint8_t addr, uint8_t reg, uint8_t value);
+    bool readRegisters(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len);
+};
+#endif
+
+struct Bmp280Sample
+{
+    int32_t temperature;    // 0.01 degC
+    uint32_t pressure;      // Pa in Q24.8 (divide by 256 for Pa)
+    uint32_t humidity;      // %RH in Q22.10 (divide by 1024 for %RH), BME280 only
+};
+
+/*
+    BMP280/BME280 driver running the sensor in forced mode.
+
+    trigger() starts a conversion and returns immediately; read() fetches
+    all data registers in a single I2C burst once the sensor is idle again.
+    Calling read() then trigger() once per log cycle keeps loop() free of
+    any conversion wait: the conversion (< 50 ms even at x16) finishes long
+    before the next cycle. Compensation uses the datasheet's integer
+    formulas only.
+*/
+class Bmp280
+{
+public:
+    bool begin(Bmp280Bus* bus, uint8_t addr);
+
+    // Oversampling per channel and IIR filter; applied from the next trigger()
+    void configure(uint8_t osrsT, uint8_t osrsP, uint8_t osrsH, uint8_t filter);
+
+    bool trigger();
+
+    // False if the sensor is missing, still converting or was never triggered
+    bool read(Bmp280Sample* sample);
+
+    bool hasHumidity() const { return chipId_ == BME280_CHIP_ID; }
+    bool present() const { return chipId_ != 0; }
+
+private:
+    Bmp280Bus* bus_;
+    uint8_t addr_;
+    uint8_t chipId_;
+    uint8_t ctrlMeas_;
+    bool triggered_;
+
+    // calibration
+    uint16_t digT1_;
+    int16_t digT2_, digT3_;
+    uint16_t digP1_;
+    int16_t digP2_, digP3_, digP4_, digP5_, digP6_, digP7_, digP8_, digP9_;
+    uint8_t digH1_, digH3_;
+    int16_t digH2_, digH4_, digH5_;
+    int8_t digH6_;
+
+    bool readCalibration();
+    int32_t compensateT(int32_t adcT, int32_t* tFine) const;
+    uint32_t compensateP(int32_t adcP, int32_t tFine) const;
+    uint32_t compensateH(int32_t adcH, int32_t tFine) const;
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef Channels_h
+#define Channels_h
+
+#include <Arduino.h>
+
+#include "LogSchema.h"
+
+/*
+    Firmware side of the channel table declared in LogSchema.h.
+
+    Channel<Field> holds one channel's static accumulator and calls the
+    field's sample function directly; LogStream<Record> drives all fields
+    of a stream. Everything is resolved at compile time, so there is no
+    virtual dispatch and no table walk at run time.
+
+        LogStream<TempLog>::poll(millis());     // samples whatever is due
+        if (LogStream<TempLog>::due(millis()))
+            LogStream<TempLog>::take(values);   // reduced values, restart
+
+    Sampling and logging keep to their nominal periods: each deadline is
+    the previous one plus the interval, not the tick that happened to
+    serve it, so a late tick does not push the ones after it back. After
+    a stall of two intervals or more they start again from the current
+    tick instead of catching up.
+
+    A REDUCE_LAST channel is not sampled on its own timer; take() reads it
+    once, so the record has its value as of the log time.
+*/
+
+struct ChannelAccumulator
+{
+    int32_t value;
+    uint16_t count;
+};
+
+template <Reduction R> struct Reducer;
+
+template <> struct Reducer<REDUCE_LAST>
+{
+    static void add(ChannelAccumulator& a, int32_t v) { a.value = v; }
+    static int32_t result(const ChannelAccumulator& a) { return a.value; }
+};
+
+template <> struct Reducer<REDUCE_MEAN>
+{
+    static void add(ChannelAccumulator& a, int32_t v) { a.value += v; }
+    static int32_t result(const ChannelAccumulator& a)
+    {
+        // round half away from zero
+        int32_t half = a.count / 2;
+        return (a.value + (a.value < 0 ? -half : half)) / (int32_t)a.count;
+    }
+};
+
+template <> struct Reducer<REDUCE_MIN>
+{
+    static void add(ChannelAccumulator& a, int32_t v) { if (a.count == 0 || v < a.value) a.value = v; }
+    static int32_t result(const ChannelAccumulator& a) { return a.value; }
+};
+
+template <> struct Reducer<REDUCE_MAX>
+{
+    static void add(ChannelAccumulator& a, int32_t v) { if (a.count == 0 || v > a.value) a.value = v; }
+    static int32_t result(const ChannelAccumulator& a) { return a.value; }
+};
+
+template <> struct Reducer<REDUCE_SUM>
+{
+    static void add(ChannelAccumulator& a, int32_t v) { a.value += v; }
+    static int32_t result(const ChannelAccumulator& a) { return a.value; }
+};
+
+template <typename Field>
+struct Channel
+{
+    static ChannelAccumulator acc;
+    static uint32_t lastSample;
+    static bool sampled;
+
+    static void poll(uint32_t now)
+    {
+        if (Field::reduction == REDUCE_LAST)
+            return;
+        if (sampled && now - lastSample < Field::sampleMs)
+            return;
+
+        if (sampled && now - lastSample < 2UL * Field::sampleMs)
+            lastSample += Field::sampleMs;
+        else
+            lastSample = now;
+        sampled = true;
+        sample();
+    }
+
+    // Reduced value of the current window (LOG_MISSING if it holds no
+    // samples), then start a new one
+    static int32_t take()
+    {
+        if (Field::reduction == REDUCE_LAST)
+            sample();
+
+        int32_t v = acc.count ? Reducer<Field::reduction>::result(acc) : LOG_MISSING;
+        acc.value = 0;
+        acc.count = 0;
+        return v;
+    }
+
+    static void sample()
+    {
+        int32_t v;
+        if (Field::sample(&v))
+        {
+            Reducer<Field::reduction>::add(acc, v);
+            acc.count++;
+        }
+    }
+};
+
+template <typename Field> ChannelAccumulator Channel<Field>::acc;
+template <typename Field> uint32_t Channel<Field>::lastSample;
+template <typename Field> bool Channel<Field>::sampled;
+
+template <typename List> struct ChannelOps;
+
+template <> struct ChannelOps<FieldList<> >
+{
+    static void poll(uint32_t) {}
+    static void take(int32_t*) {}
+};
+
+template <typename First, typename... Rest>
+struct ChannelOps<FieldList<First, Rest...> >
+{
+    static void poll(uint32_t now)
+    {
+        Channel<First>::poll(now);
+        ChannelOps<FieldList<Rest...> >::poll(now);
+    }
+
+    static void take(int32_t* values)
+    {
+        values[0] = Channel<First>::take();
+        ChannelOps<FieldList<Rest...> >::take(values + 1);
+    }
+};
+
+template <typename Record>
+struct LogStream
+{
+    static uint32_t lastLog;
+
+    // Sample every channel whose interval has elapsed, in declaration order
+    static void poll(uint32_t now)
+    {
+        ChannelOps<typename Record::fields>::poll(now);
+    }
+
+    // True once per log interval; the caller must then take()
+    static bool due(uint32_t now)
+    {
+        if (now - lastLog < Record::logMs)
+            return false;
+
+        if (now - lastLog < 2UL * Record::logMs)
+            lastLog += Record::logMs;
+        else
+            lastLog = now;
+        return true;
+    }
+
+    // Reduced value of every channel (Record::fieldCount of them), and
+    // restart the windows
+    static void take(int32_t* values)
+    {
+        ChannelOps<typename Record::fields>::take(values);
+    }
+};
+
+template <typename Record> uint32_t LogStream<Record>::lastLog;
+
+#endif
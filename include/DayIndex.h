@@ -0,0 +1,91 @@
+#ifndef DayIndex_h
+#define DayIndex_h
+
+#include <Arduino.h>
+
+#include <SD.h>
+
+#include "LogSchema.h"
+
+// One index per year, next to its month directories: /LOGS/<year>/INDEX.BIN
+#define DAY_INDEX_FILE "INDEX.BIN"
+
+// Days (since 1970) before this one are taken for a clock NTP has not set
+// yet and are not indexed
+#define DAY_INDEX_FIRST_DAY 18262   // 2020-01-01
+
+// How often the open day's slot is rewritten, so a reset loses at most
+// this much of its extremes (s)
+#define DAY_INDEX_SAVE_S 3600
+
+// Slots one printJson() call reads at most while skipping days without
+// logs
+#define DAY_INDEX_SCAN_SLOTS 16
+
+// Start of an index file. Slot n describes day firstDay + n; a file
+// whose entrySize is not sizeof(DayIndexEntry) is from an older schema
+// and is started over
+struct DayIndexHeader
+{
+    uint16_t firstDay;      // the first day of its year with logs
+    uint16_t entrySize;
+};
+
+// One slot per day
+struct DayIndexEntry
+{
+    uint16_t day;           // days since 1970, 0 for a slot without logs
+    uint16_t channels;      // bit n: LogChannel n logged at least one value
+    uint32_t dataBytes;     // size of the day's DATA.BIN
+    int32_t min[LOG_CHANNEL_COUNT];
+    int32_t max[LOG_CHANNEL_COUNT];
+};
+
+static_assert(LOG_CHANNEL_COUNT <= 16, "DayIndexEntry::channels holds 16 channels");
+
+/*
+    Compact index of the logged days.
+
+    /LOGS/<year>/INDEX.BIN is a DayIndexHeader and an array of
+    DayIndexEntry from the first day of that year with logs on, so any day
+    is one seek away and a year is one small sequential read: the web
+    server never has to walk /LOGS/<year>/<month>/<day> to find out what
+    exists. The first save of a year writes a single slot; only a gap of
+    days without logs is filled with empty slots, at most a year of them.
+
+    The open day lives in RAM and is written to its slot when the day
+    closes (the first record of the next day) and every DAY_INDEX_SAVE_S.
+*/
+class DayIndex
+{
+public:
+    // Fold one reduced record of Stream into the extremes of its day
+    template <typename Stream>
+    void add(uint32_t time, const int32_t* values)
+    {
+        add(time, Stream::firstChannel, values, Stream::fieldCount);
+    }
+
+    void add(uint32_t time, uint8_t firstChannel, const int32_t* values, uint8_t count);
+
+    // Current size of the open day's DATA.BIN
+    void setDataBytes(uint32_t bytes) { today_.dataBytes = bytes; }
+
+    // Write the open day to its slot
+    bool save();
+
+    // JSON array of the indexed days of one year (0 for the current one),
+    // oldest first, a part per call: the opening bracket, then one day, or the
+    // open day and the closing bracket once none are left; false after
+    // that. cursor starts at 0 and file closed, both kept between calls
+    bool printJson(Print& out, uint16_t year, File& file, uint32_t& cursor);
+
+private:
+    DayIndexEntry today_;
+    uint32_t lastSave_;
+
+    void load(uint16_t day);
+    void printEntry(Print& out, const DayIndexEntry& e, bool first);
+};
+
+#endif
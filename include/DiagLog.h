@@ -0,0 +1,100 @@
+#ifndef DiagLog_h
+#define DiagLog_h
+
+#include <Arduino.h>
+
+#define DIAG_LEVEL_NONE 0
+#define DIAG_LEVEL_ERROR 1
+#define DIAG_LEVEL_WARN 2
+#define DIAG_LEVEL_INFO 3
+#define DIAG_LEVEL_DEBUG 4
+
+// Messages above this level are compiled out entirely (format string,
+// arguments and call); override with -DDIAG_LEVEL=... in build_flags
+#ifndef DIAG_LEVEL
+#define DIAG_LEVEL DIAG_LEVEL_INFO
+#endif
+
+#ifndef DIAG_BAUD
+#define DIAG_BAUD 115200
+#endif
+
+// RAM ring buffer between the log calls and the UART
+#ifndef DIAG_BUFFER_SIZE
+#define DIAG_BUFFER_SIZE 256
+#endif
+
+// Longest single formatted message, longer ones are truncated
+#define DIAG_LINE_MAX 96
+
+/*
+    Non-blocking diagnostics on the serial port.
+
+    DIAG_INFO("x=%d", x) and friends format a PROGMEM format string into
+    the ring buffer and return; drain() later moves whatever fits into the
+    UART's transmit buffer without waiting, so a log call never stalls the
+    loop at any baud rate. A message that does not fit in the ring is
+    dropped whole and counted; the count is reported in the stream once
+    there is room again.
+
+    Used as a Print (diag.print(...), printStats(diag)) the logger is
+    lossless instead: when the ring is full it drains synchronously. Keep
+    that for rare bulk dumps.
+*/
+class DiagLog : public Print
+{
+public:
+    void begin(unsigned long baud = DIAG_BAUD);
+
+    void log(char level, PGM_P format, ...);
+
+    // Move buffered bytes to the UART without blocking
+    void drain();
+
+    // Block until everything buffered has been handed to the UART
+    void flush();
+
+    uint32_t dropped() const { return droppedTotal_; }
+
+    size_t write(uint8_t c);
+    using Print::write;
+
+private:
+    char ring_[DIAG_BUFFER_SIZE];
+    uint16_t head_;     // next byte to write
+    uint16_t tail_;     // next byte to send
+    uint16_t pendingDrops_;
+    uint32_t droppedTotal_;
+
+    uint16_t used() const { return (head_ - tail_ + DIAG_BUFFER_SIZE) % DIAG_BUFFER_SIZE; }
+    uint16_t space() const { return DIAG_BUFFER_SIZE - 1 - used(); }
+    void put(const char* s, uint16_t len);
+};
+
+extern DiagLog diag;
+
+#if DIAG_LEVEL >= DIAG_LEVEL_ERROR
+#define DIAG_ERROR(fmt, ...) diag.log('E', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define DIAG_ERROR(fmt, ...) do {} while (0)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_WARN
+#define DIAG_WARN(fmt, ...) diag.log('W', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define DIAG_WARN(fmt, ...) do {} while (0)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_INFO
+#define DIAG_INFO(fmt, ...) diag.log('I', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define DIAG_INFO(fmt, ...) do {} while (0)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_DEBUG
+#define DIAG_DEBUG(fmt, ...) diag.log('D', PSTR(fmt), ##__VA_ARGS__)
+#else
+#define DIAG_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+#endif
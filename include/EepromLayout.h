@@ -0,0 +1,19 @@
+#ifndef EepromLayout_h
+#define EepromLayout_h
+
+// Byte ranges of the ATmega2560's 4 KB EEPROM owned by each module.
+// Keep the regions disjoint; append new ones at the end.
+
+// RainGauge: ring of cumulative-total slots (see RainGauge.h)
+#define EEPROM_RAIN_BASE 0
+#define EEPROM_RAIN_SIZE 256
+
+// LogQueue: overflow of the pending-record queue (see LogQueue.h)
+#define EEPROM_SPILL_BASE 256
+#define EEPROM_SPILL_SIZE 3824
+
+// LogWriter: day whose files may have been open at a reset (see LogWriter.h)
+#define EEPROM_LOG_DAY_BASE 4080
+#define EEPROM_LOG_DAY_SIZE 16
+
+#endif
@@ -0,0 +1,308 @@
+#ifndef HttpServer_h
+#define HttpServer_h
+
+#include <Arduino.h>
+#include <Ethernet.h>
+#include <SD.h>
+
+#include "Template.h"
+
+// Connections served at once; each holds a W5100 socket while open
+#define HTTP_MAX_CONNECTIONS 2
+
+// Longest request line kept, the rest is dropped
+#define HTTP_LINE_MAX 96
+
+// Start of a request header line kept for parsing; enough for
+// "connection: keep-alive", an ETag in If-None-Match and the usual
+// Accept-Encoding lists
+#define HTTP_FIELD_MAX 40
+
+// Request bytes read from the socket at a time. What follows the end of
+// one request stays here for the next, so pipelined requests survive
+#define HTTP_RX_BUF 32
+
+// Header lines a response can queue, status line included
+#define HTTP_MAX_HEADERS 6
+
+// RAM a generated body is gathered in before it goes out as one chunk
+#define HTTP_CHUNKED_BUF 256
+
+// Files are sent in chunks of whole SD blocks: the chunk is read with
+// the card holding the bus, then written to the socket with the W5100
+// holding it. A chunk is only read once the socket's TX buffer has room
+// for all of it, so it must not exceed that buffer (2 KB per socket)
+#define HTTP_CHUNK 512
+
+// Generated bodies go out one part at a time, a part only once the
+// socket has room for all of it: HTTP_PART_MAX bytes, as two full
+// chunks with their size lines, plus the terminating empty chunk. A part
+// never prints more, so its output never waits for the client
+#define HTTP_PART_MAX (2 * HTTP_CHUNKED_BUF)
+#define HTTP_PART_ROOM (2 * (HTTP_CHUNKED_BUF + 7) + 5)
+
+// A template is read from flash and rendered this many bytes at a time,
+// one piece per part. Even with a short value in every few bytes a piece
+// stays within HTTP_PART_MAX
+#define HTTP_TEMPLATE_PIECE 128
+
+// A connection that neither reads nor writes a byte for this long is dropped
+#define HTTP_TIMEOUT 5000
+
+// A kept-alive connection is closed after this long without a new
+// request; short, as every idle connection holds one of the W5100's
+// four sockets
+#define HTTP_IDLE_TIMEOUT 2000
+
+// Requests served on one connection before it is closed
+#define HTTP_MAX_REQUESTS 32
+
+// How long stop() waits for the peer to acknowledge the close
+#define HTTP_CLOSE_TIMEOUT 50
+
+// Event streams open at once. Each holds a connection for as long as the
+// viewer stays, so at least one connection is always left for pages
+#define HTTP_MAX_EVENT_STREAMS 1
+
+// Longest event, "data: " and the blank line after it included; every
+// reading at its widest takes 192 today
+#define HTTP_EVENT_MAX 224
+
+// An event stream without events gets a comment line this often, so a
+// peer that went away without closing is found out by the W5100's
+// retransmission timeout rather than never
+#define HTTP_EVENT_HEARTBEAT 15000
+
+enum HttpState
+{
+    HTTP_FREE,
+    HTTP_REQUEST,   // reading the request line and headers
+    HTTP_RESPONSE,  // queued headers and body going out
+    HTTP_EVENTS     // open event stream, written by HttpServer::publish()
+};
+
+class HttpConnection;
+
+// Prints the next part of a generated body, at most HTTP_PART_MAX bytes,
+// and moves conn.cursor() past it; false once that was the last part
+typedef bool (*HttpGenerator)(HttpConnection& conn, Print& out);
+
+/*
+    One client connection.
+
+    Nothing here waits on the network. The request is read as it arrives;
+    once its headers are in, the handler queues header lines and a body
+    with header() and body(), render(), generate() or sendFile(). Those
+    go out from pump(), each only when the socket has room for it, so a
+    slow reader holds its own connection back instead of the main loop.
+
+    A response gets Content-Length (a rendered or generated one is
+    chunked) and Connection headers and keeps the connection open for the
+    next request when the client asked for that (HTTP/1.1 unless
+    "Connection: close", HTTP/1.0 only with "Connection: keep-alive").
+    HTTP/1.0 clients do not know chunked encoding; they get the plain
+    bytes and the connection closes after them.
+*/
+class HttpConnection
+{
+public:
+    HttpConnection() : state_(HTTP_FREE) {}
+
+    HttpState state() const { return state_; }
+
+    // The request line, modifiable in place by the handler
+    char* request() { return line_; }
+
+    // line must be a PSTR(); ignored once HTTP_MAX_HEADERS are queued
+    void header(PGM_P line);
+
+    // Send a PSTR() as the body after the queued headers
+    void body(PGM_P text);
+
+    // Send length bytes of PROGMEM data as the body after the queued headers
+    void body(PGM_P data, uint32_t length);
+
+    // Send length bytes of a PROGMEM template as the body, its {{name}}
+    // placeholders filled in by resolve as it goes out. The length is
+    // only known at the end, so the body is chunked
+    void render(PGM_P data, uint32_t length, TemplateResolver resolve);
+
+    // Send the parts gen prints as the body after the queued headers,
+    // chunked. The handler may set cursor() first; file, if given, stays
+    // open for gen as file() and is closed after the last part
+    void generate(HttpGenerator gen);
+    void generate(HttpGenerator gen, File& file);
+
+    // Where a generator left off, and its file
+    uint32_t& cursor() { return cursor_; }
+    File& file() { return file_; }
+
+    // Answer with 304 and no body; queue the ETag after this
+    void notModified();
+
+    // Request headers: Accept-Encoding lists gzip, If-None-Match names etag
+    bool acceptsGzip() const { return gzip_; }
+    bool etagMatches(uint32_t etag) const { return hasEtag_ && etag_ == etag; }
+
+    // Send file as the body after the queued headers, then close it
+    void sendFile(File& file);
+
+private:
+    friend class HttpServer;
+    friend class ChunkedWriter;
+
+    EthernetClient client_;
+    File file_;
+    TemplateRenderer renderer_;
+    HttpGenerator generator_;   // NULL if none
+    PGM_P headers_[HTTP_MAX_HEADERS];
+    PGM_P text_;                // body() or render(), NULL if none
+    uint32_t cursor_;
+    uint32_t etag_;             // from If-None-Match
+    uint32_t length_;           // body bytes
+    uint16_t textPos_;          // body() bytes written
+    char line_[HTTP_LINE_MAX];
+    char field_[HTTP_FIELD_MAX];
+    uint8_t rx_[HTTP_RX_BUF];
+    uint8_t rxPos_;
+    uint8_t rxLen_;
+    uint8_t lineLen_;           // bytes in line_, or field_ once requestDone_
+    uint8_t headerCount_;
+    uint8_t headerIndex_;       // next header to write, see headerLine()
+    uint8_t requests_;          // served on this connection
+    bool requestDone_;          // request line complete, now reading headers
+    bool http11_;
+    bool keepAlive_;
+    bool streaming_;            // chunked body
+    bool rendering_;            // text_ is a template
+    bool noBody_;               // 304, no Content-Length either
+    bool gzip_;
+    bool hasEtag_;
+    bool hasBody_;              // request has a body, which is not read
+    HttpState state_;
+    uint32_t lastProgress_;
+
+    void open(const EthernetClient& client);
+    void reset();
+    bool received() const { return requestDone_ || lineLen_; }
+    bool readRequest();
+    void parseField();
+    uint8_t headerLine(uint8_t index, char* line);
+    void beginChunked();
+    bool pump();
+    bool sendEvent(const uint8_t* data, uint8_t len);
+    bool watchEvents();
+    bool sent();
+    void close();
+};
+
+/*
+    One part of a chunked body, for pump().
+
+    Whatever is printed collects in HTTP_CHUNKED_BUF bytes of RAM and
+    goes out as one chunk when that is full, so a part leaves in a socket
+    write or two rather than one per print(). suspend() sends what is
+    left and lets the next part carry on; end(), or the destructor, also
+    sends the terminating empty chunk, after which the connection can
+    take its next request. An HTTP/1.0 client gets the bare bytes.
+
+    The writes go straight to the socket: pump() only starts a part once
+    there is HTTP_PART_ROOM for it.
+*/
+class ChunkedWriter : public Print
+{
+public:
+    ChunkedWriter(HttpConnection& conn);
+    ~ChunkedWriter() { end(); }
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buf, size_t size) override;
+    using Print::write;
+
+    void end();
+
+    // Sends what is buffered but leaves the body open, for a later
+    // writer on the same connection to carry on
+    void suspend();
+
+private:
+    HttpConnection& conn_;
+    uint16_t len_;
+    bool ended_;
+    // Room for the size line in front and the CRLF behind the data
+    uint8_t buf_[5 + HTTP_CHUNKED_BUF + 2];
+
+    void flush();
+};
+
+struct HttpStats
+{
+    uint32_t accepted;
+    uint32_t requests;
+    uint32_t reused;        // requests on a kept-alive connection
+    uint32_t served;        // connections closed after the last response
+    uint32_t dropped;       // closed by HTTP_TIMEOUT, or an event stream
+                            // too far behind
+    uint32_t events;        // sent to event streams
+    uint16_t eventsRefused; // subscriptions over HTTP_MAX_EVENT_STREAMS
+    uint16_t rpsPeak;       // most requests in one second
+};
+
+typedef void (*HttpHandler)(HttpConnection& conn);
+
+// Prints the data of one event, a single line
+typedef void (*HttpEventPrinter)(Print& out);
+
+/*
+    Non-blocking web server on top of an EthernetServer.
+
+    poll() accepts new connections while a slot is free, reads pending
+    requests, runs the handler for each complete one and pushes queued
+    responses as far as the sockets take them. It returns true while some
+    response moved and has more to send, so the caller can come back on
+    the next pass instead of waiting for the next poll interval.
+
+    Requests are counted in one second buckets: rps() is the count of the
+    last full second, rpsPeak the highest since boot.
+
+    A handler can turn its connection into a Server-Sent Events stream
+    with subscribe(). The connection then stays open without a length,
+    and every publish() writes one "data:" event to all streams at once.
+    A stream is closed when the peer closes or resets it, and dropped
+    when an event no longer fits its TX buffer: a viewer that stopped
+    reading 2 KB ago is not coming back.
+*/
+class HttpServer
+{
+public:
+    HttpServer(EthernetServer& server, HttpHandler handler) : server_(server), handler_(handler) {}
+
+    bool poll();
+
+    const HttpStats& stats() const { return stats_; }
+    uint16_t rps() const;
+
+    // Makes conn an event stream and sends it a first event from print,
+    // if given; false, with nothing sent, if HTTP_MAX_EVENT_STREAMS are
+    // already open
+    bool subscribe(HttpConnection& conn, HttpEventPrinter print);
+
+    // Sends the event print produces to every event stream
+    void publish(HttpEventPrinter print);
+
+    void printJson(Print& out) const;
+
+private:
+    EthernetServer& server_;
+    HttpHandler handler_;
+    HttpConnection conns_[HTTP_MAX_CONNECTIONS];
+    HttpStats stats_;
+    uint32_t rateStart_;    // millis() at the start of the current second
+    uint16_t rateCount_;
+    uint16_t rateLast_;
+
+    void countRequest();
+    uint8_t eventStreams() const;
+};
+
+#endif
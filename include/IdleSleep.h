@@ -0,0 +1,57 @@
+#ifndef IdleSleep_h
+#define IdleSleep_h
+
+#include <Arduino.h>
+
+/*
+    Idle sleep between scheduler deadlines.
+
+    sleepFor() puts the CPU in SLEEP_MODE_IDLE until the requested time has
+    passed or the Ethernet controller pulls its INT line. Timers, SPI, the
+    UARTs and the ADC keep running in idle mode, so millis(), serial output
+    and the sensor interrupts are unaffected; the Timer0 tick wakes the core
+    every ~1 ms to re-check the deadline.
+
+    The wind vane's conversion interrupt follows each tick ~104 us later
+    (see WindVane.h), so the core wakes about twice per ms. Those ADC wakes
+    are counted apart from the others. Interrupt time counts as sleep: the
+    tick and the vane's ISR take a few us per ms between them, so the duty
+    cycle reads under 1 % low.
+
+    The W5100/W5500 is set up to raise INT on any socket event, so the
+    network poll only has to touch the SPI bus when something happened.
+    Call clearNetworkInterrupts() after serving so the line deasserts and
+    the next event produces a fresh edge.
+*/
+class IdleSleep
+{
+public:
+    // intPin must be an external interrupt pin wired to the controller's INT
+    void begin(uint8_t intPin);
+
+    // True once per Ethernet interrupt since the last call
+    bool takeNetworkEvent();
+
+    // Acknowledge all socket interrupts on the controller (uses SPI)
+    void clearNetworkInterrupts();
+
+    void sleepFor(uint32_t ms);
+
+    // Share of time awake since the last resetStats(), in 0.1 % units
+    uint16_t dutyCyclePermille() const;
+
+    void printStats(Print& out) const;
+    void resetStats();
+
+private:
+    static void onNetworkInterrupt();
+    static volatile bool networkEvent_;
+
+    uint32_t windowStartUs_;
+    uint32_t sleptUs_;
+    uint32_t sleeps_;
+    uint32_t adcWakes_;
+    uint32_t networkWakes_;
+};
+
+#endif
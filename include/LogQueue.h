@@ -0,0 +1,80 @@
+#ifndef LogQueue_h
+#define LogQueue_h
+
+#include <Arduino.h>
+
+#include "EepromLayout.h"
+
+// RAM part of the queue; about 13 minutes of records at the default
+// log intervals
+#ifndef LOG_QUEUE_RAM
+#define LOG_QUEUE_RAM 512
+#endif
+
+// Spill records that do not fit in RAM to EEPROM; 0 drops them instead
+#ifndef LOG_QUEUE_EEPROM
+#define LOG_QUEUE_EEPROM 1
+#endif
+
+// RAM bytes queued above which spill() moves the oldest records to
+// EEPROM, leaving the rest of the ring for records pushed meanwhile
+#define LOG_QUEUE_SPILL_AT (LOG_QUEUE_RAM / 2)
+
+/*
+    FIFO of encoded binary records (see LogSchema.h) waiting to be
+    written to the card.
+
+    Records are pushed to a RAM ring. Once it is more than half full the
+    oldest records move to a second ring in EEPROM (about 100 more
+    minutes), so the order is always EEPROM (older) then RAM (newer); when
+    both are full the oldest record is dropped and counted. An EEPROM
+    write takes ~3.4 ms a byte, so push() never spills: spill() copies one
+    byte per call and only when the EEPROM is idle, and the caller runs it
+    from a task of its own while spillPending(). Should RAM fill up before
+    the spill catches up, push() drops the oldest RAM record.
+
+    A record id that does not give a size means that ring is corrupt; the
+    whole ring is dropped and counted as one record.
+
+    The queue itself lives in RAM: its contents do not survive a reset.
+*/
+class LogQueue
+{
+public:
+    // size must be logRecordSize(record[0])
+    void push(const uint8_t* record, uint8_t size);
+
+    // Copy the oldest record into buf (LOG_RECORD_MAX bytes); returns its
+    // size, 0 if the queue is empty
+    uint8_t peek(uint8_t* buf);
+
+    // Remove the record peek() returned
+    void pop();
+
+    // Move at most one byte towards EEPROM without waiting on it; true
+    // while there is more to spill
+    bool spill();
+    bool spillPending() const { return LOG_QUEUE_EEPROM && ramUsed_ > LOG_QUEUE_SPILL_AT; }
+
+    bool empty() const { return !ramUsed_ && !eepromUsed_; }
+    uint16_t bytes() const { return ramUsed_ + eepromUsed_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    uint8_t ram_[LOG_QUEUE_RAM];
+    uint16_t ramHead_;
+    uint16_t ramUsed_;
+    uint16_t eepromHead_;
+    uint16_t eepromUsed_;
+    uint8_t spilled_;       // bytes of the oldest RAM record already in EEPROM
+    uint32_t dropped_;
+
+    uint8_t ramAt(uint16_t i) const { return ram_[(ramHead_ + i) % LOG_QUEUE_RAM]; }
+    uint8_t eepromAt(uint16_t i) const;
+    uint8_t ramHeadSize();
+    uint8_t eepromHeadSize();
+    void popRam(uint8_t size);
+    void popEeprom(uint8_t size);
+};
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef LogSchema_h
+#define LogSchema_h
+
+#include <stdint.h>
+#include <string.h>
+#include <stdlib.h>
+
+/*
+    The one description of what the station logs, shared by the firmware
+    (which samples, reduces and writes the records) and host tools such as
+    tools/logexport.cpp (which read them back). It only depends on the C
+    library so it compiles unchanged on both sides.
+
+    Every stream is one file per day (TEMP.LOG, ...) plus its records in
+    the day's binary DATA.BIN. A channel is one line in its stream's field
+    list:
+
+        X(name, unit, decimals, width, reduction, sample function, sample ms)
+
+    - values are fixed point int32_t with `decimals` decimals (21.37 degC
+      with 2 decimals is 2137)
+    - `width` is the field's size in a binary record: 1, 2 or 4 bytes
+    - the sample function and interval are only used by the firmware; the
+      function is declared here and defined in main.cpp. A REDUCE_LAST
+      channel is sampled once per record, at log time, whatever its
+      interval (see Channels.h)
+
+    Adding a channel is one line in a *_LOG_FIELDS list. That changes the
+    stream's binary layout, so also give the stream a new record id to keep
+    existing DATA.BIN files from being misread. (Ids 1-4 were the layout
+    without the check byte.)
+*/
+
+#define TEMP_LOG_FIELDS(X) \
+    X(temperature,  "degC", 2, 2, REDUCE_MEAN, sampleTemperature,     2000)
+
+#define PRESSURE_LOG_FIELDS(X) \
+    X(pressure,     "hPa",  2, 4, REDUCE_MEAN, samplePressure,        10000) \
+    X(baroTemp,     "degC", 2, 2, REDUCE_MEAN, sampleBaroTemperature, 10000) \
+    X(humidity,     "%RH",  2, 2, REDUCE_MEAN, sampleHumidity,        10000)
+
+#define WIND_LOG_FIELDS(X) \
+    X(windDir,      "deg",  1, 2, REDUCE_LAST, sampleWindDirection,   60000) \
+    X(windSteady,   "",     2, 1, REDUCE_LAST, sampleWindSteadiness,  60000)
+
+#define RAIN_LOG_FIELDS(X) \
+    X(rainTotal,    "mm",   2, 4, REDUCE_LAST, sampleRainTotal,       10000) \
+    X(rainRate,     "mm/h", 2, 2, REDUCE_MAX,  sampleRainRate,        10000)
+
+// X(type, file name, record id, field list, log interval ms)
+#define LOG_STREAMS(X) \
+    X(TempLog,      "TEMP.LOG",     5, TEMP_LOG_FIELDS,     60000) \
+    X(PressureLog,  "PRESSURE.LOG", 6, PRESSURE_LOG_FIELDS, 60000) \
+    X(WindLog,      "WIND.LOG",     7, WIND_LOG_FIELDS,     60000) \
+    X(RainLog,      "RAIN.LOG",     8, RAIN_LOG_FIELDS,     60000)
+
+// Name of the per-day file holding the binary records of every stream
+#define LOG_BINARY_FILE "DATA.BIN"
+
+// ----------------------------------------------------------------------
+
+enum Reduction
+{
+    REDUCE_LAST,
+    REDUCE_MEAN,
+    REDUCE_MIN,
+    REDUCE_MAX,
+    REDUCE_SUM
+};
+
+// Value of a channel that had no samples in its window
+#define LOG_MISSING ((int32_t)(-2147483647L - 1))
+
+#ifdef ARDUINO
+#include <avr/pgmspace.h>
+// Schema strings live in flash; wrap them for Print with SCHEMA_PRINTABLE
+#define SCHEMA_STR(s) PSTR(s)
+#define SCHEMA_CHAR(p) ((char)pgm_read_byte(p))
+#define SCHEMA_PRINTABLE(s) reinterpret_cast<const __FlashStringHelper*>(s)
+#else
+#define SCHEMA_STR(s) (s)
+#define SCHEMA_CHAR(p) (*(p))
+#define SCHEMA_PRINTABLE(s) (s)
+#endif
+
+// Print a fixed point value, e.g. (2137, 2) -> "21.37". Out is anything
+// with Arduino Print style print(char) and print(unsigned long).
+template <typename Out>
+void printFixed(Out& out, int32_t value, uint8_t decimals)
+{
+    uint32_t mag = (uint32_t)value;
+    if (value < 0)
+    {
+        out.print('-');
+        mag = 0 - mag;
+    }
+
+    uint32_t div = 1;
+    for (uint8_t i = 0; i < decimals; i++)
+        div *= 10;
+
+    out.print((unsigned long)(mag / div));
+    if (!decimals)
+        return;
+
+    out.print('.');
+    uint32_t frac = mag % div;
+    for (uint32_t d = div / 10; d > 1 && frac < d; d /= 10)
+        out.print('0');
+    out.print((unsigned long)frac);
+}
+
+// Parse what printFixed() wrote; returns the end of the number or 0
+inline const char* parseFixed(const char* s, uint8_t decimals, int32_t* value)
+{
+    bool negative = *s == '-';
+    if (negative)
+        s++;
+    if (*s < '0' || *s > '9')
+        return 0;
+
+    int32_t v = 0;
+    while (*s >= '0' && *s <= '9')
+        v = v * 10 + (*s++ - '0');
+
+    uint8_t seen = 0;
+    if (*s == '.')
+    {
+        s++;
+        while (*s >= '0' && *s <= '9')
+        {
+            if (seen < decimals)
+            {
+                v = v * 10 + (*s - '0');
+                seen++;
+            }
+            s++;
+        }
+    }
+    for (; seen < decimals; seen++)
+        v *= 10;
+
+    *value = negative ? -v : v;
+    return s;
+}
+
+// Little endian two's complement field of Width bytes. The most negative
+// value of each width encodes LOG_MISSING; others saturate.
+template <uint8_t Width> struct FieldCodec
+{
+    static const int32_t lowest = -(int32_t)(((uint32_t)1 << (8 * Width - 1)) - 1);
+    static const int32_t highest = (int32_t)(((uint32_t)1 << (8 * Width - 1)) - 1);
+
+    static void put(uint8_t* p, int32_t v)
+    {
+        uint32_t u;
+        if (v == LOG_MISSING)
+            u = (uint32_t)1 << (8 * Width - 1);
+        else
+            u = (uint32_t)(v < lowest ? lowest : v > highest ? highest : v);
+
+        for (uint8_t i = 0; i < Width; i++)
+            p[i] = u >> (8 * i);
+    }
+
+    static int32_t get(const uint8_t* p)
+    {
+        uint32_t u = 0;
+        for (uint8_t i = 0; i < Width; i++)
+            u |= (uint32_t)p[i] << (8 * i);
+
+        uint32_t sign = (uint32_t)1 << (8 * Width - 1);
+        if (u == sign)
+            return LOG_MISSING;
+        return (int32_t)((u ^ sign) - sign);    // sign extend
+    }
+};
+
+template <> struct FieldCodec<4>
+{
+    static void put(uint8_t* p, int32_t v)
+    {
+        uint32_t u = (uint32_t)v;
+        p[0] = u;
+        p[1] = u >> 8;
+        p[2] = u >> 16;
+        p[3] = u >> 24;
+    }
+
+    static int32_t get(const uint8_t* p)
+    {
+        return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    }
+};
+
+template <typename... Fields> struct FieldList;
+
+template <> struct FieldList<>
+{
+    static const uint8_t count = 0;
+    static const uint8_t width = 0;
+
+    static void encode(uint8_t*, const int32_t*) {}
+    static void decode(const uint8_t*, int32_t*) {}
+    template <typename Out> static void printText(Out&, const int32_t*) {}
+    template <typename Out> static void printHeader(Out&) {}
+    template <typename Out> static void printJson(Out&, const int32_t*) {}
+    static bool parseText(const char*, int32_t*) { return true; }
+};
+
+template <typename First, typename... Rest>
+struct FieldList<First, Rest...>
+{
+    typedef FieldList<Rest...> Tail;
+
+    static const uint8_t count = 1 + Tail::count;
+    static const uint8_t width = First::width + Tail::width;
+
+    static void encode(uint8_t* p, const int32_t* values)
+    {
+        FieldCodec<First::width>::put(p, values[0]);
+        Tail::encode(p + First::width, values + 1);
+    }
+
+    static void decode(const uint8_t* p, int32_t* values)
+    {
+        values[0] = FieldCodec<First::width>::get(p);
+        Tail::decode(p + First::width, values + 1);
+    }
+
+    template <typename Out>
+    static void printText(Out& out, const int32_t* values)
+    {
+        out.print(' ');
+        if (values[0] == LOG_MISSING)
+            out.print('-');
+        else
+            printFixed(out, values[0], First::decimals);
+        Tail::printText(out, values + 1);
+    }
+
+    template <typename Out>
+    static void printHeader(Out& out)
+    {
+        out.print(',');
+        out.print(SCHEMA_PRINTABLE(First::name()));
+        if (SCHEMA_CHAR(First::unit()))
+        {
+            out.print('[');
+            out.print(SCHEMA_PRINTABLE(First::unit()));
+            out.print(']');
+        }
+        Tail::printHeader(out);
+    }
+
+    // ,"name":value for every field, null for LOG_MISSING
+    template <typename Out>
+    static void printJson(Out& out, const int32_t* values)
+    {
+        out.print(",\"");
+        out.print(SCHEMA_PRINTABLE(First::name()));
+        out.print("\":");
+        if (values[0] == LOG_MISSING)
+            out.print("null");
+        else
+            printFixed(out, values[0], First::decimals);
+        Tail::printJson(out, values + 1);
+    }
+
+    static const uint8_t firstChannel = First::channel;
+
+    static bool parseText(const char* s, int32_t* values)
+    {
+        while (*s == ' ')
+            s++;
+        if (*s == '-' && (s[1] == ' ' || s[1] == 0 || s[1] == '\r' || s[1] == '\n'))
+        {
+            values[0] = LOG_MISSING;
+            s++;
+        }
+        else if (!(s = parseFixed(s, First::decimals, values)))
+            return false;
+        return Tail::parseText(s, values + 1);
+    }
+};
+
+// CRC-8, polynomial 0x07
+inline uint8_t logCrc8(const uint8_t* p, uint8_t n)
+{
+    uint8_t crc = 0;
+    while (n--)
+    {
+        crc ^= *p++;
+        for (uint8_t i = 0; i < 8; i++)
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+/*
+    One stream's record layout.
+
+    Text line:      HH:MM:SS   v1 v2 ...            ('-' for LOG_MISSING)
+    Binary record:  id (1) | unix time (4) | fields (width each) | crc (1),
+                    little endian; crc is logCrc8() of the bytes before it
+
+    The id and check byte let a reader find record boundaries again in a
+    damaged file, e.g. a day file recovered after a reset.
+*/
+template <uint8_t Id, uint32_t LogMs, typename... Fields>
+struct Record
+{
+    typedef FieldList<Fields...> fields;
+
+    static const uint8_t id = Id;
+    static const uint32_t logMs = LogMs;
+    static const uint8_t fieldCount = fields::count;
+    static const uint8_t binarySize = 1 + 4 + fields::width + 1;
+    static const uint8_t firstChannel = fields::firstChannel;
+
+    // buf must hold binarySize bytes
+    static void encode(uint8_t* buf, uint32_t time, const int32_t* values)
+    {
+        buf[0] = Id;
+        FieldCodec<4>::put(buf + 1, time);
+        fields::encode(buf + 5, values);
+        buf[binarySize - 1] = logCrc8(buf, binarySize - 1);
+    }
+
+    // False if buf is not an intact record of this stream
+    static bool decode(const uint8_t* buf, uint32_t* time, int32_t* values)
+    {
+        if (buf[0] != Id || buf[binarySize - 1] != logCrc8(buf, binarySize - 1))
+            return false;
+        *time = FieldCodec<4>::get(buf + 1);
+        fields::decode(buf + 5, values);
+        return true;
+    }
+
+    // The values after the timestamp, including the leading separator
+    template <typename Out>
+    static void printText(Out& out, const int32_t* values)
+    {
+        out.print("  ");
+        fields::printText(out, values);
+    }
+
+    // Parse a text line; secondsOfDay gets the HH:MM:SS prefix
+    static bool parseText(const char* line, uint32_t* secondsOfDay, int32_t* values)
+    {
+        if (strlen(line) < 8 || line[2] != ':' || line[5] != ':')
+            return false;
+
+        *secondsOfDay = atol(line) * 3600UL + atol(line + 3) * 60UL + atol(line + 6);
+        return fields::parseText(line + 8, values);
+    }
+
+    // CSV header: "time,name[unit],..."
+    template <typename Out>
+    static void printHeader(Out& out)
+    {
+        out.print("time");
+        fields::printHeader(out);
+    }
+};
+
+// ----------------------------------------------------------------------
+// Generated types: one <name>Field per channel, one struct per stream
+
+// Every channel of every stream numbered in declaration order, for tables
+// indexed by channel: LOG_CHANNEL_temperature, LOG_CHANNEL_pressure, ...
+// A stream's channels are consecutive, starting at Type::firstChannel.
+#define LOG_SCHEMA_CHANNEL_ID(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    LOG_CHANNEL_##Name,
+#define LOG_SCHEMA_CHANNEL_IDS(Type, File, Id, Fields, LogMs) \
+    Fields(LOG_SCHEMA_CHANNEL_ID)
+
+enum LogChannel
+{
+    LOG_STREAMS(LOG_SCHEMA_CHANNEL_IDS)
+    LOG_CHANNEL_COUNT
+};
+
+#ifdef ARDUINO
+#define LOG_SCHEMA_BINDING(Sample, SampleMs) \
+    static bool sample(int32_t* value) { return Sample(value); } \
+    static const uint16_t sampleMs = SampleMs;
+#define LOG_SCHEMA_DECLARE(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    bool Sample(int32_t* value);
+#else
+#define LOG_SCHEMA_BINDING(Sample, SampleMs)
+#define LOG_SCHEMA_DECLARE(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs)
+#endif
+
+#define LOG_SCHEMA_FIELD(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    LOG_SCHEMA_DECLARE(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    struct Name##Field \
+    { \
+        static const char* name() { return SCHEMA_STR(#Name); } \
+        static const char* unit() { return SCHEMA_STR(Unit); } \
+        static const uint8_t decimals = Decimals; \
+        static const uint8_t width = Width; \
+        static const uint8_t channel = LOG_CHANNEL_##Name; \
+        static const Reduction reduction = Reduce; \
+        LOG_SCHEMA_BINDING(Sample, SampleMs) \
+    };
+
+#define LOG_SCHEMA_LIST(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    , Name##Field
+
+#define LOG_SCHEMA_STREAM(Type, File, Id, Fields, LogMs) \
+    Fields(LOG_SCHEMA_FIELD) \
+    struct Type : Record<Id, LogMs Fields(LOG_SCHEMA_LIST)> \
+    { \
+        static const char* fileName() { return SCHEMA_STR(File); } \
+    };
+
+LOG_STREAMS(LOG_SCHEMA_STREAM)
+
+// Size of a binary record by its id byte, 0 if no stream uses the id
+inline uint8_t logRecordSize(uint8_t id)
+{
+#define LOG_SCHEMA_RECORD_SIZE(Type, File, Id, Fields, LogMs) \
+    if (id == Id) \
+        return Type::binarySize;
+    LOG_STREAMS(LOG_SCHEMA_RECORD_SIZE)
+#undef LOG_SCHEMA_RECORD_SIZE
+    return 0;
+}
+
+// True if buf starts with an intact record of any stream
+inline bool logRecordValid(const uint8_t* buf)
+{
+    uint8_t size = logRecordSize(buf[0]);
+    return size && buf[size - 1] == logCrc8(buf, size - 1);
+}
+
+// Buffer size that holds a binary record of any stream
+#define LOG_RECORD_MAX 32
+
+#define LOG_SCHEMA_CHECK_SIZE(Type, File, Id, Fields, LogMs) \
+    static_assert(Type::binarySize <= LOG_RECORD_MAX, #Type " record exceeds LOG_RECORD_MAX");
+LOG_STREAMS(LOG_SCHEMA_CHECK_SIZE)
+#undef LOG_SCHEMA_CHECK_SIZE
+
+#endif
@@ -0,0 +1,105 @@
+#ifndef LogWriter_h
+#define LogWriter_h
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "DayIndex.h"
+#include "LogQueue.h"
+#include "LogSchema.h"
+
+// Re-initialisation backoff while the card is missing or failing (ms).
+// A failed SD.begin() can itself take up to ~2 s.
+#define LOG_RETRY_MIN_MS 1000
+#define LOG_RETRY_MAX_MS 60000
+
+// Most records written per service() call, so a long backlog is flushed
+// over several sensor ticks
+#define LOG_FLUSH_BATCH 32
+
+// The open day files are synced after this many records or this long
+// after the first unsynced one, whichever comes first; a reset loses at
+// most that window (less whatever recover() finds on the card)
+#define LOG_SYNC_RECORDS 16
+#define LOG_SYNC_MS 120000UL
+
+#define LOG_WRITER_STREAM_INDEX(Type, File, Id, Fields, LogMs) LOG_STREAM_##Type,
+enum LogStreamIndex { LOG_STREAMS(LOG_WRITER_STREAM_INDEX) LOG_STREAM_COUNT };
+#undef LOG_WRITER_STREAM_INDEX
+
+/*
+    Write-ahead path from the sensor tick to the card.
+
+    append() only encodes the record into the LogQueue, so logging never
+    depends on the card. service() appends whatever is queued to the day
+    files (DATA.BIN and the stream's text log) and removes a record from
+    the queue once it is written. Any open or write failure marks the card
+    as gone; service() then retries SD.begin() with exponential backoff
+    and flushes the backlog when the card is back.
+
+    The day's files stay open and are only synced every LOG_SYNC_RECORDS
+    records or LOG_SYNC_MS, instead of being closed after every record.
+    The day being written is kept in EEPROM; after a reset recover() scans
+    that day's files past their recorded size for records that reached the
+    card but not the directory entry (binary records by id and check byte,
+    text lines by parsing them) and extends the size to the last valid one.
+*/
+class LogWriter
+{
+public:
+    // Runs recover() if the card is present
+    void begin(uint8_t csPin, bool cardOk, DayIndex* index);
+
+    template <typename Stream>
+    void append(uint32_t time, const int32_t* values)
+    {
+        uint8_t record[Stream::binarySize];
+        Stream::encode(record, time, values);
+        queue_.push(record, sizeof(record));
+    }
+
+    void service();
+
+    // One step of moving the backlog to EEPROM, see LogQueue::spill()
+    bool spill() { return queue_.spill(); }
+
+    // Sync the open files now
+    void sync();
+
+    bool cardOk() const { return cardOk_; }
+    const LogQueue& queue() const { return queue_; }
+
+    // {"card":...,"queued":...,"dropped":...,"reinits":...,"recovered":...}
+    void printJson(Print& out) const;
+
+private:
+    struct DayFiles
+    {
+        uint16_t day;       // 0 when nothing is open
+        char path[20];      // /LOGS/yyyy/m/d
+        File binary;
+        File text[LOG_STREAM_COUNT];
+    };
+
+    LogQueue queue_;
+    DayFiles files_;
+    DayIndex* index_;
+    uint8_t csPin_;
+    bool cardOk_;
+    uint32_t retryAt_;
+    uint32_t backoff_;
+    uint16_t reinits_;
+    uint8_t unsynced_;
+    uint32_t unsyncedSince_;
+    uint32_t recovered_;    // bytes brought back by recover()
+    uint8_t textId_;        // id and time of a queued record whose text
+    uint32_t textTime_;     // line is written but not its binary one
+
+    bool flush();
+    bool openDay(uint32_t time);
+    void closeDay();
+    void cardFailed();
+    void recover();
+};
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef MemoryMonitor_h
+#define MemoryMonitor_h
+
+#include <Arduino.h>
+
+// Byte written over all free RAM at boot
+#define MEMORY_PAINT 0xC5
+
+struct MemoryStats
+{
+    uint16_t staticSize;    // .data + .bss
+    uint16_t heapSize;      // heap break above __heap_start, now
+    uint16_t heapPeak;      // largest heapSize seen by update()
+    uint16_t heapFree;      // bytes on malloc's free list
+    uint16_t largestFree;   // biggest malloc() that would succeed now
+    uint8_t fragmentation;  // % of free heap not in the largest block
+    uint16_t stackSize;     // RAMEND - SP, now
+    uint16_t stackPeak;     // deepest stack since boot (see below)
+    uint16_t untouched;     // painted bytes never written since boot
+};
+
+/*
+    SRAM usage of the ATmega2560.
+
+    Everything between the static data and the top of RAM is painted with
+    MEMORY_PAINT from .init3, before any constructor runs. update() scans
+    upward from the heap break for the first byte that is no longer paint;
+    everything above it has been stack at some point. Bytes the heap used
+    and gave back also stop being paint, so stackPeak is an upper bound
+    and untouched a lower bound, which is the safe direction when sizing
+    buffers.
+
+    The scan is linear in the untouched area (a few hundred us for 4 KB);
+    call update() from a slow task, not the hot path.
+*/
+class MemoryMonitor
+{
+public:
+    void update();
+
+    const MemoryStats& stats() const { return stats_; }
+
+    void printStats(Print& out) const;
+    void printJson(Print& out) const;
+
+private:
+    MemoryStats stats_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef PerfCounters_h
+#define PerfCounters_h
+
+#include <Arduino.h>
+
+// Set to 0 to compile every PERF_SCOPE out
+#ifndef PERF_ENABLED
+#define PERF_ENABLED 1
+#endif
+
+// X(id, name) of every timed section
+#define PERF_SECTIONS(X) \
+    X(SENSOR,       "sensor") \
+    X(SD_OPEN,      "sd_open") \
+    X(SD_READ,      "sd_read") \
+    X(SD_WRITE,     "sd_write") \
+    X(SD_SYNC,      "sd_sync") \
+    X(ONEWIRE,      "onewire") \
+    X(I2C,          "i2c") \
+    X(NTP,          "ntp") \
+    X(HTTP_PARSE,   "http_parse") \
+    X(HTTP_SERVE,   "http_serve")
+
+#define PERF_ENUM(id, name) PERF_##id,
+enum PerfSection
+{
+    PERF_SECTIONS(PERF_ENUM)
+    PERF_SECTION_COUNT
+};
+#undef PERF_ENUM
+
+// log2 histogram of durations: bin n counts [2^n, 2^(n+1)) us, the last
+// bin everything from 2^(PERF_BINS-1) us (~16 ms) up
+#define PERF_BINS 15
+
+struct PerfStats
+{
+    uint32_t count;
+    uint32_t totalMs;       // whole ms moved out of totalUs
+    uint16_t totalUs;       // remainder below 1 ms
+    uint32_t maxUs;
+    uint16_t hist[PERF_BINS];   // saturating
+};
+
+/*
+    Per-section timing counters kept in SRAM.
+
+    PERF_SCOPE(SD_WRITE) times the rest of the enclosing block with
+    micros() (4 us resolution) and folds the duration into count, total,
+    max and a log2 histogram; the cost is two micros() calls and a few
+    adds, small enough to leave on in the field.
+*/
+class PerfCounters
+{
+public:
+    void record(uint8_t section, uint32_t us);
+
+    const PerfStats& stats(uint8_t section) const { return stats_[section]; }
+    static const char* name(uint8_t section);   // PROGMEM string
+
+    void reset();
+
+    void printTable(Print& out) const;
+    void printJson(Print& out) const;
+
+    // "name":{...} of one section, the members of printJson()'s object
+    void printJson(Print& out, uint8_t section) const;
+
+private:
+    PerfStats stats_[PERF_SECTION_COUNT];
+};
+
+extern PerfCounters perf;
+
+class PerfScope
+{
+public:
+    PerfScope(uint8_t section) : section_(section), start_(micros()) {}
+    ~PerfScope() { perf.record(section_, micros() - start_); }
+
+private:
+    uint8_t section_;
+    uint32_t start_;
+};
+
+// PERF_SCOPE times to the end of the enclosing block; PERF_BEGIN/PERF_END
+// bracket a span that does not match a block
+#if PERF_ENABLED
+#define PERF_SCOPE(id) PerfScope perfScope_##id(PERF_##id)
+#define PERF_BEGIN(id) uint32_t perfStart_##id = micros()
+#define PERF_END(id) perf.record(PERF_##id, micros() - perfStart_##id)
+#else
+#define PERF_SCOPE(id) do {} while (0)
+#define PERF_BEGIN(id) do {} while (0)
+#define PERF_END(id) do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef RainGauge_h
+#define RainGauge_h
+
+#include <Arduino.h>
+
+#include "EepromLayout.h"
+
+// Rain collected per bucket tip, in micrometres (0.2794 mm is the usual
+// tipping-bucket volume for the common 55 cm^2 funnel)
+#define RAIN_UM_PER_TIP 279
+
+// Reed switches bounce for a few ms; real tips are >= 0.5 s apart even in
+// a cloudburst
+#define RAIN_DEBOUNCE_MS 50
+
+// Sliding window for the rain rate: RAIN_RATE_BUCKETS buckets of
+// RAIN_RATE_BUCKET_MS each (12 x 5 min = 1 hour)
+#define RAIN_RATE_BUCKETS 12
+#define RAIN_RATE_BUCKET_MS 300000UL
+
+// How often rollup() should run: the cumulative total is persisted at
+// most this often, and only if it changed
+#define RAIN_PERSIST_MS 60000UL
+
+// Wear spreading: each save goes to the next slot of this ring
+#define RAIN_EEPROM_SLOTS (EEPROM_RAIN_SIZE / sizeof(RainGauge::Slot))
+
+/*
+    Interrupt driven tipping-bucket rain gauge.
+
+    The ISR only debounces and bumps a tip counter; totals and the rate
+    window are updated in sample(), once per log cycle, and rollup()
+    persists the total every RAIN_PERSIST_MS. The pin is never polled.
+*/
+class RainGauge
+{
+public:
+    struct Slot
+    {
+        uint16_t seq;
+        uint32_t tips;
+        uint8_t check;
+        uint8_t reserved;
+    };
+
+    void begin(uint8_t pin);
+
+    // Fold new tips into the totals and advance the rate window. Call from
+    // the main loop only.
+    void sample();
+
+    // Persist the cumulative total if it changed since the last save
+    void rollup();
+
+    // Cumulative tips since the gauge was installed (survives reboots)
+    uint32_t totalTips() const { return totalTips_; }
+
+    // Cumulative rain in mm
+    float totalMm() const;
+
+    // Rain rate in mm/h over the sliding window
+    float rateMmPerHour() const;
+
+    // Write the cumulative total to EEPROM right away
+    void persist();
+
+private:
+    static void onTip();
+
+    static volatile uint16_t isrTips_;
+    static volatile uint32_t isrLastTipMs_;
+
+    uint16_t seenTips_;
+    uint32_t totalTips_;
+    uint32_t persistedTips_;
+
+    uint16_t buckets_[RAIN_RATE_BUCKETS];
+    uint8_t bucketIndex_;
+    uint32_t bucketStartMs_;
+
+    uint8_t slot_;
+    uint16_t seq_;
+
+    void load();
+    static uint8_t checksum(const Slot& slot);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef Scheduler_h
+#define Scheduler_h
+
+#include <Arduino.h>
+
+#define SCHEDULER_MAX_TASKS 8
+
+#define SCHEDULER_STOPPED 0xFF
+
+typedef void (*TaskCallback)(void);
+
+struct TaskStats
+{
+    uint32_t runs;
+    uint32_t lateSum;       // ms, sum of (start - deadline)
+    uint16_t lateMax;       // ms
+    uint16_t overruns;      // deadlines dropped because a whole interval was missed
+};
+
+/*
+    Deadline ordered cooperative scheduler.
+
+    Tasks sit in a binary min-heap keyed on their next deadline, so run()
+    only looks at the heap top and dispatches just the tasks that are due;
+    idle passes cost one comparison. timeUntilNext() tells the caller how
+    long it may idle.
+
+    Deadlines are millis() values compared with wrap-safe arithmetic. A
+    task that falls more than one interval behind is rescheduled from now
+    rather than run back-to-back to catch up.
+*/
+class Scheduler
+{
+public:
+    Scheduler() : count_(0), active_(0) {}
+
+    // name must be a PSTR(); returns the task id or -1 if the table is full
+    int8_t add(PGM_P name, TaskCallback callback, uint32_t intervalMs, uint32_t firstDelayMs = 0);
+
+    // Run a task at the next run() regardless of its deadline; restarts a
+    // stopped task
+    void wake(int8_t id);
+
+    // Take a task off the schedule until the next wake()
+    void stop(int8_t id);
+
+    void setInterval(int8_t id, uint32_t intervalMs);
+
+    // Dispatch every task that is due; returns how many ran
+    uint8_t run();
+
+    // ms until the earliest deadline, 0 if something is due
+    uint32_t timeUntilNext() const;
+
+    const TaskStats& stats(int8_t id) const { return tasks_[id].stats; }
+    uint8_t taskCount() const { return count_; }
+
+    void printStats(Print& out) const;
+
+private:
+    struct Task
+    {
+        PGM_P name;
+        TaskCallback callback;
+        uint32_t interval;
+        uint32_t deadline;
+        uint8_t heapPos;    // SCHEDULER_STOPPED when not scheduled
+        TaskStats stats;
+    };
+
+    Task tasks_[SCHEDULER_MAX_TASKS];
+    uint8_t heap_[SCHEDULER_MAX_TASKS];
+    uint8_t count_;     // tasks added
+    uint8_t active_;    // tasks in the heap
+
+    bool earlier(uint8_t a, uint8_t b) const
+    {
+        return (int32_t)(tasks_[a].deadline - tasks_[b].deadline) < 0;
+    }
+    void insert(uint8_t id);
+    void swap(uint8_t i, uint8_t j);
+    void siftUp(uint8_t pos);
+    void siftDown(uint8_t pos);
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef SdInventory_h
+#define SdInventory_h
+
+#include <Arduino.h>
+#include <SD.h>
+
+// Directories nested deeper than this are counted but not entered;
+// /LOGS/<year>/<month>/<day> needs 4 below the root
+#define SD_INVENTORY_DEPTH 5
+
+/*
+    Incremental listing of the SD card.
+
+    The recursive walk this replaces ran to completion inside setup(),
+    so boot time grew with every day logged. Here the walk keeps its open
+    directories on an explicit stack and step() lists at most a given
+    number of entries per call, so it can run as a background task a
+    slice at a time with bounded stack use.
+*/
+class SdInventory
+{
+public:
+    // Start (or restart) the walk at path
+    void begin(const char* path);
+
+    // List up to maxEntries more entries to out; false once the walk has
+    // finished
+    bool step(Print& out, uint8_t maxEntries);
+
+    bool done() const { return depth_ == 0; }
+    uint16_t files() const { return files_; }
+    uint16_t dirs() const { return dirs_; }
+    uint32_t bytes() const { return bytes_; }
+
+private:
+    File stack_[SD_INVENTORY_DEPTH];
+    uint8_t depth_;
+    uint16_t files_;
+    uint16_t dirs_;
+    uint32_t bytes_;
+
+    void close();
+};
+
+#endif
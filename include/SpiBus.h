@@ -0,0 +1,56 @@
+#ifndef SpiBus_h
+#define SpiBus_h
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// X(id, name) of every device on the shared bus
+#define SPI_DEVICES(X) \
+    X(SD,       "sd") \
+    X(ETHERNET, "ethernet")
+
+#define SPI_DEVICE_ENUM(id, name) SPI_DEVICE_##id,
+enum SpiDevice
+{
+    SPI_DEVICES(SPI_DEVICE_ENUM)
+    SPI_DEVICE_COUNT
+};
+#undef SPI_DEVICE_ENUM
+
+struct SpiDeviceStats
+{
+    uint32_t transactions;
+    uint32_t reconfigs;     // transactions that changed SPCR/SPSR
+};
+
+/*
+    Arbitration of the SPI bus shared by the SD card and the W5100.
+
+    acquire() begins an SPI transaction with the device's settings and
+    release() ends it, so the owner holds the bus for its whole critical
+    section. On AVR that is two register writes; acquire() also counts
+    the transactions that found the registers set up for something else.
+
+    Only transactions this tree starts go through here: the SD driver via
+    its sdSpiBegin()/sdSpiEnd() hooks and our own W5100 register accesses.
+    The Ethernet library's socket traffic does not, so the ethernet counts
+    are a lower bound; the sd reconfigs show how often it got in between.
+*/
+class SpiBus
+{
+public:
+    void acquire(uint8_t device, const SPISettings& settings);
+    void release(uint8_t device);
+
+    const SpiDeviceStats& stats(uint8_t device) const { return stats_[device]; }
+    static const char* name(uint8_t device);    // PROGMEM string
+
+    void printJson(Print& out) const;
+
+private:
+    SpiDeviceStats stats_[SPI_DEVICE_COUNT];
+};
+
+extern SpiBus spiBus;
+
+#endif
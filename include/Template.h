@@ -0,0 +1,52 @@
+#ifndef Template_h
+#define Template_h
+
+#include <Arduino.h>
+
+// Longest placeholder name, terminator included; longer ones are left as
+// they are
+#define TEMPLATE_NAME_MAX 16
+
+// Prints the value of placeholder name to out; false if there is no such
+// value, which leaves the placeholder in the page as written
+typedef bool (*TemplateResolver)(const char* name, Print& out);
+
+/*
+    Replaces {{name}} placeholders in a page while it is being sent.
+
+    The page goes through write() in whatever pieces it is read in, and
+    the output goes straight on to out. A placeholder may be cut anywhere
+    between two pieces: the part seen so far is held back (at most
+    TEMPLATE_NAME_MAX + 3 bytes) until the rest arrives, so nothing but
+    that has to be buffered. Names are letters, digits and '_'; anything
+    else after "{{", an unknown name or a page ending inside a placeholder
+    leaves the text unchanged.
+*/
+class TemplateRenderer
+{
+public:
+    void begin(TemplateResolver resolve);
+
+    void write(const uint8_t* data, size_t size, Print& out);
+
+    // Writes out what is still held back at the end of the page
+    void end(Print& out);
+
+private:
+    enum State
+    {
+        TEXT,
+        OPEN,       // after '{'
+        NAME,       // after "{{"
+        CLOSE       // after "{{name}"
+    };
+
+    TemplateResolver resolve_;
+    State state_;
+    uint8_t nameLen_;
+    char name_[TEMPLATE_NAME_MAX];
+
+    void literal(Print& out);
+};
+
+#endif
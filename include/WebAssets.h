@@ -0,0 +1,35 @@
+#ifndef WebAssets_h
+#define WebAssets_h
+
+#include <Arduino.h>
+
+/*
+    Dashboard pages compiled into flash by tools/webassets.py.
+
+    Every file in sd-card/ becomes a PROGMEM array, gzipped when that is
+    smaller, and an entry in a route table; "" routes to INDEX.HTM.
+    Templates stay uncompressed, as they are rendered on the way out. The
+    header lines are PROGMEM strings ready for HttpConnection::header(),
+    and the ETag is a hash of the stored bytes.
+
+    The pointers are near (16 bit) PROGMEM pointers. The arrays land in
+    .progmem right after the vector table, well inside the first 64 KB
+    of flash, as long as the pages stay a few tens of KB.
+*/
+struct WebAsset
+{
+    PGM_P path;             // as requested, without the leading '/'
+    PGM_P type;             // "Content-Type: ..." line
+    PGM_P etagHeader;       // "ETag: ..." line
+    uint32_t etag;
+    const uint8_t* data;
+    uint16_t length;
+    bool gzip;              // data is gzip, only for clients accepting that
+    bool tmpl;              // data has {{name}} placeholders, see Template.h
+};
+
+// The asset served for path, matched case-insensitively like the card's
+// 8.3 names; false if there is none
+bool findWebAsset(const char* path, WebAsset* asset);
+
+#endif
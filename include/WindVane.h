@@ -0,0 +1,61 @@
+#ifndef WindVane_h
+#define WindVane_h
+
+#include <Arduino.h>
+
+// Conversions are triggered by the Timer0 overflow that drives millis(),
+// one every 1.024 ms; every WIND_VANE_DECIMATION-th one is folded into the
+// average (~160 Hz). Free-running instead would wake an idle core every
+// ~104 us for conversions that are thrown away.
+#define WIND_VANE_DECIMATION 6
+
+// Vector components in the sector table are scaled to +-WIND_VANE_UNIT
+#define WIND_VANE_UNIT 127
+
+struct WindVaneSample
+{
+    float direction;        // circular mean, degrees clockwise from north
+    uint8_t sector;         // 0..15, 0 = N, 4 = E, ...
+    float steadiness;       // length of the mean unit vector, 0..1
+    uint16_t count;         // samples that went into the mean
+};
+
+/*
+    Resistor-ladder wind vane on an analog pin, sampled by the ADC on
+    every Timer0 overflow.
+
+    The ADC interrupt maps each (decimated) conversion to one of 16
+    sectors and adds that sector's unit vector to a running sum; read()
+    turns the sum into a circular mean and restarts it. Nothing ever waits
+    on a conversion. The conversion interrupt arrives ~104 us after the
+    millis() tick, so IdleSleep sees it as a wake of its own;
+    conversions() lets it tell those apart.
+
+    This takes over the ADC: analogRead() must not be used while the vane
+    is running.
+*/
+class WindVane
+{
+public:
+    void begin(uint8_t channel);
+
+    // Mean direction since the previous read(); false if no samples yet
+    bool read(WindVaneSample* sample);
+
+    static const char* sectorName(uint8_t sector);
+
+    // Called from the ADC interrupt
+    static void onConversion(uint16_t value);
+
+    // Conversion interrupts so far, wrapping
+    static uint8_t conversions() { return conversions_; }
+
+private:
+    static volatile int32_t sumX_;
+    static volatile int32_t sumY_;
+    static volatile uint16_t count_;
+    static volatile uint8_t skip_;
+    static volatile uint8_t conversions_;
+};
+
+#endif
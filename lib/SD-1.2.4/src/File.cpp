@@ -145,6 +145,36 @@ uint32_t File::size() {
   return _file->fileSize();
 }
 
+uint32_t File::allocatedSize() {
+  uint32_t size;
+  if (! _file || ! _file->allocatedSize(&size)) {
+    return 0;
+  }
+  return size;
+}
+
+uint32_t File::extendForScan() {
+  uint32_t size;
+  if (! _file || ! _file->extendForScan(&size)) {
+    return 0;
+  }
+  return size;
+}
+
+int File::readStream(uint8_t *buf) {
+  if (_file) {
+    return _file->readStream(buf);
+  }
+  return -1;
+}
+
+boolean File::setRecoveredSize(uint32_t size) {
+  if (! _file) {
+    return false;
+  }
+  return _file->setRecoveredSize(size);
+}
+
 void File::close() {
   if (_file) {
     _file->close();
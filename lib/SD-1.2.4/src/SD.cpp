@@ -348,7 +348,7 @@ namespace SDLib {
       Return true if initialization succeeds, false otherwise.
 
     */
-    return card.init(SPI_HALF_SPEED, csPin) &&
+    return card.init(SD_SCK_RATE, csPin) &&
            volume.init(card) &&
            root.openRoot(volume);
   }
@@ -23,6 +23,12 @@
 #define FILE_READ O_READ
 #define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
 
+// SPI rate for begin(csPin), see Sd2Card::setSckRate(). Full speed is
+// F_CPU/2, 8 MHz on a 16 MHz AVR; use SPI_HALF_SPEED for long wiring.
+#ifndef SD_SCK_RATE
+#define SD_SCK_RATE SPI_FULL_SPEED
+#endif
+
 namespace SDLib {
 
   class File : public Stream {
@@ -41,9 +47,16 @@ namespace SDLib {
       virtual int available();
       virtual void flush();
       int read(void *buf, uint16_t nbyte);
+      // Whole blocks for sending a file on, see SdFile::readStream()
+      int readStream(uint8_t *buf);
       boolean seek(uint32_t pos);
       uint32_t position();
       uint32_t size();
+      // Crash recovery, see SdFile::allocatedSize()/extendForScan()/
+      // setRecoveredSize()
+      uint32_t allocatedSize();
+      uint32_t extendForScan();
+      boolean setRecoveredSize(uint32_t size);
       void close();
       operator bool();
       char * name();
@@ -106,6 +119,11 @@ namespace SDLib {
         return rmdir(filepath.c_str());
       }
 
+      // The mounted volume, for capacity and free space
+      SdVolume* vol() {
+        return &volume;
+      }
+
     private:
 
       // This is used to determine the mode used to open a file
@@ -288,6 +288,41 @@ uint32_t const FAT32MASK = 0X0FFFFFFF;
 /** Type name for fat32BootSector */
 typedef struct fat32BootSector fbs_t;
 //------------------------------------------------------------------------------
+/** Lead signature for a FSINFO sector */
+uint32_t const FSINFO_LEAD_SIG = 0X41615252;
+/** Struct signature for a FSINFO sector */
+uint32_t const FSINFO_STRUCT_SIG = 0X61417272;
+/** Trail signature for a FSINFO sector */
+uint32_t const FSINFO_TRAIL_SIG = 0XAA550000;
+/** Value of freeCount and nextFree when the field is not known */
+uint32_t const FSINFO_UNKNOWN = 0XFFFFFFFF;
+/**
+   \struct fat32FSInfo
+
+   \brief FSINFO sector for a FAT32 volume.
+
+   Both counts are hints only; a volume that was not cleanly unmounted
+   may carry stale values.
+*/
+struct fat32FSInfo {
+  /** must be 0X41615252 */
+  uint32_t leadSignature;
+  /** must be zero */
+  uint8_t  reserved1[480];
+  /** must be 0X61417272 */
+  uint32_t structSignature;
+  /** last known free cluster count, 0XFFFFFFFF if unknown */
+  uint32_t freeCount;
+  /** cluster to start looking for free clusters, 0XFFFFFFFF if unknown */
+  uint32_t nextFree;
+  /** must be zero */
+  uint8_t  reserved2[12];
+  /** must be 0XAA550000 */
+  uint32_t tailSignature;
+} __attribute__((packed));
+/** Type name for fat32FSInfo */
+typedef struct fat32FSInfo fsinfo_t;
+//------------------------------------------------------------------------------
 /**
    \struct directoryEntry
    \brief FAT short directory entry
@@ -30,6 +30,14 @@
 
   #include <SPI.h>
   static SPISettings settings;
+
+// default bus hooks, see Sd2Card.h
+__attribute__((weak)) void sdSpiBegin(const SPISettings& settings) {
+  SDCARD_SPI.beginTransaction(settings);
+}
+__attribute__((weak)) void sdSpiEnd(void) {
+  SDCARD_SPI.endTransaction();
+}
 #endif
 // functions for hardware SPI
 /** Send a byte to the card */
@@ -109,11 +117,103 @@ void spiSend(uint8_t data) {
 }
 #endif  // SOFTWARE_SPI
 //------------------------------------------------------------------------------
+/** Update a CRC16-CCITT (polynomial 0X1021) as used for SD data blocks */
+static inline uint16_t crcUpdate(uint16_t crc, uint8_t data) {
+  #if SD_CRC_CHECK
+  crc = (crc >> 8) | (crc << 8);
+  crc ^= data;
+  crc ^= (crc & 0XFF) >> 4;
+  crc ^= crc << 12;
+  crc ^= (crc & 0XFF) << 5;
+  #endif  // SD_CRC_CHECK
+  return crc;
+}
+#ifdef OPTIMIZE_HARDWARE_SPI
+//------------------------------------------------------------------------------
+/** Wait for the byte on the bus to finish */
+#define spiWait() while (!(SPSR & (1 << SPIF)))
+//------------------------------------------------------------------------------
+/** Take the byte just shifted in and start the next transfer before
+    storing it, so the store overlaps the shift */
+static inline void spiRecStep(uint8_t*& dst, uint16_t& crc) {
+  spiWait();
+  uint8_t b = SPDR;
+  SPDR = 0XFF;
+  *dst++ = b;
+  crc = crcUpdate(crc, b);
+}
+//------------------------------------------------------------------------------
+/** Receive count > 0 bytes, two per iteration; returns their CRC16 */
+static uint16_t spiRecBlock(uint8_t* dst, uint16_t count) {
+  uint16_t crc = 0;
+  uint16_t n = count - 1;
+  SPDR = 0XFF;
+  if (n & 1) {
+    spiRecStep(dst, crc);
+  }
+  for (n >>= 1; n; n--) {
+    spiRecStep(dst, crc);
+    spiRecStep(dst, crc);
+  }
+  // last byte starts no new transfer
+  spiWait();
+  *dst = SPDR;
+  return crcUpdate(crc, *dst);
+}
+//------------------------------------------------------------------------------
+/** Fetch the next byte and fold it into the CRC while the previous one
+    is still on the bus */
+static inline void spiSendStep(const uint8_t*& src, uint16_t& crc) {
+  uint8_t b = *src++;
+  crc = crcUpdate(crc, b);
+  spiWait();
+  SPDR = b;
+}
+//------------------------------------------------------------------------------
+/** Send a token and a 512 byte block, two bytes per iteration; returns
+    the CRC16 of the block */
+static uint16_t spiSendBlock(uint8_t token, const uint8_t* src) {
+  uint16_t crc = 0;
+  SPDR = token;
+  for (uint16_t n = 256; n; n--) {
+    spiSendStep(src, crc);
+    spiSendStep(src, crc);
+  }
+  spiWait();
+  return crc;
+}
+#else  // OPTIMIZE_HARDWARE_SPI
+//------------------------------------------------------------------------------
+static uint16_t spiRecBlock(uint8_t* dst, uint16_t count) {
+  uint16_t crc = 0;
+  for (uint16_t i = 0; i < count; i++) {
+    dst[i] = spiRec();
+    crc = crcUpdate(crc, dst[i]);
+  }
+  return crc;
+}
+//------------------------------------------------------------------------------
+static uint16_t spiSendBlock(uint8_t token, const uint8_t* src) {
+  uint16_t crc = 0;
+  spiSend(token);
+  for (uint16_t i = 0; i < 512; i++) {
+    spiSend(src[i]);
+    crc = crcUpdate(crc, src[i]);
+  }
+  return crc;
+}
+#endif  // OPTIMIZE_HARDWARE_SPI
+//------------------------------------------------------------------------------
 // send command and return error code.  Return zero for OK
 uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   // end read if in partialBlockRead mode
   readEnd();
 
+  // end a multiple block read; readStop() comes back here with CMD12
+  if (readNext_ && cmd != CMD12) {
+    readStop();
+  }
+
   // select card
   chipSelectLow();
 
@@ -138,6 +238,11 @@ uint8_t Sd2Card::cardCommand(uint8_t cmd, uint32_t arg) {
   }
   spiSend(crc);
 
+  // skip the stuff byte that follows CMD12
+  if (cmd == CMD12) {
+    spiRec();
+  }
+
   // wait for response
   for (uint8_t i = 0; ((status_ = spiRec()) & 0X80) && i != 0XFF; i++)
     ;
@@ -179,7 +284,7 @@ void Sd2Card::chipSelectHigh(void) {
   #ifdef USE_SPI_LIB
   if (chip_select_asserted) {
     chip_select_asserted = 0;
-    SDCARD_SPI.endTransaction();
+    sdSpiEnd();
   }
   #endif
 }
@@ -188,7 +293,7 @@ void Sd2Card::chipSelectLow(void) {
   #ifdef USE_SPI_LIB
   if (!chip_select_asserted) {
     chip_select_asserted = 1;
-    SDCARD_SPI.beginTransaction(settings);
+    sdSpiBegin(settings);
   }
   #endif
   digitalWrite(chipSelectPin_, LOW);
@@ -256,6 +361,7 @@ uint8_t Sd2Card::eraseSingleBlockEnable(void) {
 */
 uint8_t Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   errorCode_ = inBlock_ = partialBlockRead_ = type_ = 0;
+  readNext_ = 0;
   chipSelectPin_ = chipSelectPin;
   // 16-bit init start time allows over a minute
   unsigned int t0 = millis();
@@ -424,40 +530,29 @@ uint8_t Sd2Card::readData(uint32_t block,
     inBlock_ = 1;
   }
 
-  #ifdef OPTIMIZE_HARDWARE_SPI
-  // start first spi transfer
-  SPDR = 0XFF;
-
-  // skip data before offset
-  for (; offset_ < offset; offset_++) {
-    while (!(SPSR & (1 << SPIF)))
-      ;
-    SPDR = 0XFF;
-  }
-  // transfer data
-  n = count - 1;
-  for (uint16_t i = 0; i < n; i++) {
-    while (!(SPSR & (1 << SPIF)))
-      ;
-    dst[i] = SPDR;
-    SPDR = 0XFF;
-  }
-  // wait for last byte
-  while (!(SPSR & (1 << SPIF)))
-    ;
-  dst[n] = SPDR;
-
-  #else  // OPTIMIZE_HARDWARE_SPI
-
   // skip data before offset
   for (; offset_ < offset; offset_++) {
     spiRec();
   }
   // transfer data
-  for (uint16_t i = 0; i < count; i++) {
-    dst[i] = spiRec();
+  {
+    uint16_t crc = spiRecBlock(dst, count);
+    #if SD_CRC_CHECK
+    if (count == 512) {
+      // whole block, check it
+      uint16_t cardCrc = spiRec() << 8;
+      cardCrc |= spiRec();
+      chipSelectHigh();
+      inBlock_ = 0;
+      if (cardCrc != crc) {
+        error(SD_CARD_ERROR_READ_CRC);
+        return false;
+      }
+      return true;
+    }
+    #endif  // SD_CRC_CHECK
+    (void)crc;
   }
-  #endif  // OPTIMIZE_HARDWARE_SPI
 
   offset_ += count;
   if (!partialBlockRead_ || offset_ >= 512) {
@@ -471,6 +566,117 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+/** Read one data block in a multiple block read sequence
+
+   \param[out] dst Pointer to the location that will receive the 512 bytes.
+
+   \note This function is used with readStart() and readStop().  The card
+   is deselected after each block so other devices may use the bus.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readData(uint8_t* dst) {
+  chipSelectLow();
+  if (!waitStartBlock()) {
+    goto fail;
+  }
+  {
+    uint16_t crc = spiRecBlock(dst, 512);
+    uint16_t cardCrc = spiRec() << 8;
+    cardCrc |= spiRec();
+    #if SD_CRC_CHECK
+    if (cardCrc != crc) {
+      error(SD_CARD_ERROR_READ_CRC);
+      goto fail;
+    }
+    #endif  // SD_CRC_CHECK
+    (void)crc;
+    (void)cardCrc;
+  }
+  readNext_++;
+  chipSelectHigh();
+  return true;
+
+fail:
+  readStop();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Start a multiple block read sequence.
+
+   \param[in] blockNumber Address of first block in sequence.
+
+   \note This function is used with readData() and readStop()
+   for optimized multiple block reads.  Any other command sent to the
+   card ends the sequence.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readStart(uint32_t blockNumber) {
+  uint32_t arg = blockNumber;
+  // use address if not SDHC card
+  if (type() != SD_CARD_TYPE_SDHC) {
+    arg <<= 9;
+  }
+  if (cardCommand(CMD18, arg)) {
+    error(SD_CARD_ERROR_CMD18);
+    goto fail;
+  }
+  readNext_ = blockNumber;
+  chipSelectHigh();
+  return true;
+
+fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** End a multiple block read sequence.
+
+  \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readStop(void) {
+  if (!readNext_) {
+    return true;
+  }
+  readNext_ = 0;
+  if (cardCommand(CMD12, 0)) {
+    error(SD_CARD_ERROR_CMD12);
+    goto fail;
+  }
+  chipSelectHigh();
+  return true;
+
+fail:
+  chipSelectHigh();
+  return false;
+}
+//------------------------------------------------------------------------------
+/**
+   Read a 512 byte block, continuing the current multiple block read when
+   \a blockNumber is the block that follows the last one read.
+
+   Reading consecutive blocks this way costs one command for the whole run
+   instead of one per block.
+
+   \param[in] blockNumber Logical block to be read.
+   \param[out] dst Pointer to the location that will receive the data.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t Sd2Card::readStream(uint32_t blockNumber, uint8_t* dst) {
+  if (!readNext_ || blockNumber != readNext_) {
+    if (!readStart(blockNumber)) {
+      return false;
+    }
+  }
+  return readData(dst);
+}
+//------------------------------------------------------------------------------
 /** Skip remaining data in a block when in partial block read mode. */
 void Sd2Card::readEnd(void) {
   if (inBlock_) {
@@ -665,33 +871,15 @@ uint8_t Sd2Card::writeData(const uint8_t* src) {
 //------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
 uint8_t Sd2Card::writeData(uint8_t token, const uint8_t* src) {
-  #ifdef OPTIMIZE_HARDWARE_SPI
-
-  // send data - optimized loop
-  SPDR = token;
-
-  // send two byte per iteration
-  for (uint16_t i = 0; i < 512; i += 2) {
-    while (!(SPSR & (1 << SPIF)))
-      ;
-    SPDR = src[i];
-    while (!(SPSR & (1 << SPIF)))
-      ;
-    SPDR = src[i + 1];
-  }
-
-  // wait for last data byte
-  while (!(SPSR & (1 << SPIF)))
-    ;
-
-  #else  // OPTIMIZE_HARDWARE_SPI
-  spiSend(token);
-  for (uint16_t i = 0; i < 512; i++) {
-    spiSend(src[i]);
-  }
-  #endif  // OPTIMIZE_HARDWARE_SPI
+  uint16_t crc = spiSendBlock(token, src);
+  #if SD_CRC_CHECK
+  spiSend(crc >> 8);
+  spiSend(crc);
+  #else  // SD_CRC_CHECK
+  (void)crc;
   spiSend(0xff);  // dummy crc
   spiSend(0xff);  // dummy crc
+  #endif  // SD_CRC_CHECK
 
   status_ = spiRec();
   if ((status_ & DATA_RES_MASK) != DATA_RES_ACCEPTED) {
@@ -23,6 +23,11 @@
    \file
    Sd2Card class
 */
+#ifndef ARDUINO
+// Native builds (the test env in platformio.ini) swap the SPI driver for a
+// card image in RAM with the same interface, see test/host/SdImageCard.h
+#include <SdImageCard.h>
+#else
 #include "Sd2PinMap.h"
 #include "SdInfo.h"
 /** Set SCK to max rate of F_CPU/2. See Sd2Card::setSckRate(). */
@@ -36,6 +41,19 @@ uint8_t const SPI_QUARTER_SPEED = 2;
    run with a standalone driver for AVR.
 */
 #define USE_SPI_LIB
+#ifdef USE_SPI_LIB
+class SPISettings;
+/**
+   Start and end an SPI transaction for the card. The defaults in
+   Sd2Card.cpp call SPI.beginTransaction() and SPI.endTransaction(); an
+   application arbitrating a shared bus may define its own.
+
+   \param[in] settings Clock, bit order and mode for the card.
+*/
+void sdSpiBegin(const SPISettings& settings);
+/** End the transaction started by sdSpiBegin(). */
+void sdSpiEnd(void);
+#endif  // USE_SPI_LIB
 /**
    Define MEGA_SOFT_SPI non-zero to use software SPI on Mega Arduinos.
    Pins used are SS 10, MOSI 11, MISO 12, and SCK 13.
@@ -87,8 +105,9 @@ uint8_t const SPI_QUARTER_SPEED = 2;
     uint8_t const  SPI_SCK_PIN = SDCARD_SCK_PIN;
   #endif
 
-  /** optimize loops for hardware SPI */
-  #ifndef USE_SPI_LIB
+  /** optimize loops for hardware SPI; with the SPI library only on AVRs
+      with SPDR, where the open transaction leaves the register to us */
+  #if !defined(USE_SPI_LIB) || defined(SPDR)
     #define OPTIMIZE_HARDWARE_SPI
   #endif
 
@@ -106,6 +125,12 @@ uint8_t const SPI_QUARTER_SPEED = 2;
 //------------------------------------------------------------------------------
 /** Protect block zero from write if nonzero */
 #define SD_PROTECT_BLOCK_ZERO 1
+/**
+   Check the CRC16 of whole data blocks read from the card and send a real
+   CRC16 with blocks written if nonzero.  The CRC is computed while the
+   bytes are on the bus; the card ignores write CRCs unless told otherwise.
+*/
+#define SD_CRC_CHECK 0
 /** init timeout ms */
 unsigned int const SD_INIT_TIMEOUT = 2000;
 /** erase timeout ms */
@@ -160,6 +185,12 @@ uint8_t const SD_CARD_ERROR_WRITE_PROGRAMMING = 0X14;
 uint8_t const SD_CARD_ERROR_WRITE_TIMEOUT = 0X15;
 /** incorrect rate selected */
 uint8_t const SD_CARD_ERROR_SCK_RATE = 0X16;
+/** card returned an error response for CMD18 (read multiple block) */
+uint8_t const SD_CARD_ERROR_CMD18 = 0X17;
+/** card returned an error response for CMD12 (stop multiple block read) */
+uint8_t const SD_CARD_ERROR_CMD12 = 0X18;
+/** CRC16 of a data block read from the card does not match */
+uint8_t const SD_CARD_ERROR_READ_CRC = 0X19;
 //------------------------------------------------------------------------------
 // card types
 /** Standard capacity V1 SD card */
@@ -176,7 +207,8 @@ uint8_t const SD_CARD_TYPE_SDHC = 3;
 class Sd2Card {
   public:
     /** Construct an instance of Sd2Card. */
-    Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0) {}
+    Sd2Card(void) : errorCode_(0), inBlock_(0), partialBlockRead_(0), type_(0),
+      readNext_(0) {}
     uint32_t cardSize(void);
     uint8_t erase(uint32_t firstBlock, uint32_t lastBlock);
     uint8_t eraseSingleBlockEnable(void);
@@ -227,7 +259,11 @@ class Sd2Card {
     uint8_t readCSD(csd_t* csd) {
       return readRegister(CMD9, csd);
     }
+    uint8_t readData(uint8_t* dst);
     void readEnd(void);
+    uint8_t readStart(uint32_t blockNumber);
+    uint8_t readStop(void);
+    uint8_t readStream(uint32_t blockNumber, uint8_t* dst);
     uint8_t setSckRate(uint8_t sckRateID);
     #ifdef USE_SPI_LIB
     uint8_t setSpiClock(uint32_t clock);
@@ -250,6 +286,7 @@ class Sd2Card {
     uint8_t partialBlockRead_;
     uint8_t status_;
     uint8_t type_;
+    uint32_t readNext_;  // next block of a multiple block read, zero if none
     // private functions
     uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
       cardCommand(CMD55, 0);
@@ -270,4 +307,5 @@ class Sd2Card {
     uint8_t writeData(uint8_t token, const uint8_t* src);
     uint8_t waitStartBlock(void);
 };
+#endif  // ARDUINO
 #endif  // Sd2Card_h
@@ -35,6 +35,13 @@
 */
 #define ALLOW_DEPRECATED_FUNCTIONS 1
 //------------------------------------------------------------------------------
+/**
+   Cluster chain checkpoints kept by each open SdFile so seekSet() into a
+   large file does not follow the chain from its first cluster.  Each one
+   costs four bytes per SdFile.  Set to zero to disable the seek cache.
+*/
+#define SEEK_CHECKPOINTS 4
+//------------------------------------------------------------------------------
 // forward declaration since SdVolume is used in SdFile
 class SdVolume;
 //==============================================================================
@@ -165,6 +172,7 @@ class SdFile : public Print {
     void clearUnbufferedRead(void) {
       flags_ &= ~F_FILE_UNBUFFERED_READ;
     }
+    uint8_t allocatedSize(uint32_t* size) const;
     uint8_t close(void);
     uint8_t contiguousRange(uint32_t* bgnBlock, uint32_t* endBlock);
     uint8_t createContiguous(SdFile* dirFile,
@@ -226,6 +234,7 @@ class SdFile : public Print {
       return dirIndex_;
     }
     static void dirName(const dir_t& dir, char* name);
+    uint8_t extendForScan(uint32_t* size);
     /** \return The total number of bytes in a file or directory. */
     uint32_t fileSize(void) const {
       return fileSize_;
@@ -275,6 +284,7 @@ class SdFile : public Print {
       return read(&b, 1) == 1 ? b : -1;
     }
     int16_t read(void* buf, uint16_t nbyte);
+    int16_t readStream(uint8_t* dst);
     int8_t readDir(dir_t* dir);
     static uint8_t remove(SdFile* dirFile, const char* fileName);
     uint8_t remove(void);
@@ -296,6 +306,7 @@ class SdFile : public Print {
       return seekSet(fileSize_);
     }
     uint8_t seekSet(uint32_t pos);
+    uint8_t setRecoveredSize(uint32_t size);
     /**
        Use unbuffered reads to access this file.  Used with Wave
        Shield ISR.  Used with Sd2Card::partialBlockRead() in WaveRP.
@@ -445,6 +456,11 @@ class SdFile : public Print {
     uint32_t  fileSize_;      // file size in bytes
     uint32_t  firstCluster_;  // first cluster of file
     SdVolume* vol_;           // volume where file is located
+    #if SEEK_CHECKPOINTS
+    // cluster with index (i + 1) << seekShift_ in the chain, zero if unknown
+    uint32_t  seekCluster_[SEEK_CHECKPOINTS];
+    uint8_t   seekShift_;     // log2 of the clusters between checkpoints
+    #endif  // SEEK_CHECKPOINTS
 
     // private functions
     uint8_t addCluster(void);
@@ -454,6 +470,14 @@ class SdFile : public Print {
     static uint8_t make83Name(const char* str, uint8_t* name);
     uint8_t openCachedEntry(uint8_t cacheIndex, uint8_t oflags);
     dir_t* readDirCache(void);
+    void seekCacheClear(void) {
+      #if SEEK_CHECKPOINTS
+      for (uint8_t i = 0; i < SEEK_CHECKPOINTS; i++) {
+        seekCluster_[i] = 0;
+      }
+      seekShift_ = 0;
+      #endif  // SEEK_CHECKPOINTS
+    }
 };
 //==============================================================================
 // SdVolume class
@@ -473,6 +497,8 @@ union cache_t {
   mbr_t    mbr;
   /** Used to access to a cached FAT boot sector. */
   fbs_t    fbs;
+  /** Used to access a cached FAT32 FSINFO sector. */
+  fsinfo_t fsinfo;
 };
 //------------------------------------------------------------------------------
 /**
@@ -482,7 +508,10 @@ union cache_t {
 class SdVolume {
   public:
     /** Create an instance of SdVolume */
-    SdVolume(void) : allocSearchStart_(2), fatType_(0) {}
+    SdVolume(void) : allocSearchStart_(2), fatType_(0),
+      freeClusters_(FSINFO_UNKNOWN), freeCountExact_(false),
+      fsInfoBlock_(0), fsInfoDirty_(0),
+      scanCluster_(0), scanFree_(0) {}
     /** Clear the cache and returns a pointer to the cache.  Used by the WaveRP
         recorder to do raw write to the SD card.  Not for normal apps.
     */
@@ -549,6 +578,23 @@ class SdVolume {
     uint32_t rootDirStart(void) const {
       return rootDirStart_;
     }
+    /** \return The number of free clusters, or 0XFFFFFFFF while it is
+        not known.  Until freeClusterCountExact() this may be the FSINFO
+        hint.  See freeClusterScan(). */
+    uint32_t freeClusterCount(void) const {
+      return freeClusters_;
+    }
+    /** \return True once freeClusterScan() has counted the free clusters. */
+    bool freeClusterCountExact(void) const {
+      return freeCountExact_;
+    }
+    uint8_t freeClusterScan(uint16_t maxBlocks);
+    /** \return The next cluster freeClusterScan() will count, zero before
+        the first call and once the count is known. */
+    uint32_t freeClusterScanPosition(void) const {
+      return scanCluster_;
+    }
+    uint8_t fsInfoSync(void);
     /** return a pointer to the Sd2Card object for this volume */
     static Sd2Card* sdCard(void) {
       return sdCard_;
@@ -593,6 +639,12 @@ class SdVolume {
     uint8_t fatType_;             // volume type (12, 16, OR 32)
     uint16_t rootDirEntryCount_;  // number of entries in FAT16 root dir
     uint32_t rootDirStart_;       // root start block for FAT16, cluster for FAT32
+    uint32_t freeClusters_;       // free cluster count, FSINFO_UNKNOWN if unknown
+    bool freeCountExact_;         // freeClusters_ counted, not the FSINFO hint
+    uint32_t fsInfoBlock_;        // FSINFO block for FAT32, zero if none
+    uint8_t fsInfoDirty_;         // fsInfoSync() will write FSINFO if true
+    uint32_t scanCluster_;        // next cluster for freeClusterScan()
+    uint32_t scanFree_;           // free clusters below scanCluster_
     //----------------------------------------------------------------------------
     uint8_t allocContiguous(uint32_t count, uint32_t* curCluster);
     uint8_t blockOfCluster(uint32_t position) const {
@@ -618,6 +670,7 @@ class SdVolume {
       return fatPut(cluster, 0x0FFFFFFF);
     }
     uint8_t freeChain(uint32_t cluster);
+    void freeCountAdjust(uint32_t cluster, int8_t delta);
     uint8_t isEOC(uint32_t cluster) const {
       return  cluster >= (fatType_ == 16 ? FAT16EOC_MIN : FAT32EOC_MIN);
     }
@@ -628,6 +681,9 @@ class SdVolume {
                      uint16_t count, uint8_t* dst) {
       return sdCard_->readData(block, offset, count, dst);
     }
+    uint8_t readStream(uint32_t block, uint8_t* dst) {
+      return sdCard_->readStream(block, dst);
+    }
     uint8_t writeBlock(uint32_t block, const uint8_t* dst, uint8_t blocking = 1) {
       return sdCard_->writeBlock(block, dst, blocking);
     }
@@ -65,6 +65,50 @@ uint8_t SdFile::addDirCluster(void) {
   return true;
 }
 //------------------------------------------------------------------------------
+/**
+   Bytes in the file's cluster chain.
+
+   This is fileSize() rounded up to whole clusters, unless data was written
+   after the last sync() and the file was never closed, for example after a
+   reset; then the chain can hold records the directory entry does not yet
+   count. See setRecoveredSize().
+
+   \param[out] size Allocated size in bytes.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t SdFile::allocatedSize(uint32_t* size) const {
+  if (!isFile()) {
+    return false;
+  }
+  if (firstCluster_ == 0) {
+    *size = 0;
+    return true;
+  }
+  return vol_->chainSize(firstCluster_, size);
+}
+//------------------------------------------------------------------------------
+/**
+   Let reads run to the end of the cluster chain without recording it.
+
+   Only the open file's size in RAM changes; the directory entry keeps the
+   old size until setRecoveredSize() writes the end that was found, so a
+   reset during the scan leaves the file as it was.
+
+   \param[out] size Allocated size in bytes, the new fileSize().
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t SdFile::extendForScan(uint32_t* size) {
+  if (!allocatedSize(size)) {
+    return false;
+  }
+  fileSize_ = *size;
+  return true;
+}
+//------------------------------------------------------------------------------
 // cache a file's directory entry
 // return pointer to cached entry or null for failure
 dir_t* SdFile::cacheDirEntry(uint8_t action) {
@@ -632,6 +676,7 @@ uint8_t SdFile::openCachedEntry(uint8_t dirIndex, uint8_t oflag) {
   // set to start of file
   curCluster_ = 0;
   curPosition_ = 0;
+  seekCacheClear();
 
   // truncate file to zero length if requested
   if (oflag & O_TRUNC) {
@@ -677,6 +722,7 @@ uint8_t SdFile::openRoot(SdVolume* vol) {
   // set to start of file
   curCluster_ = 0;
   curPosition_ = 0;
+  seekCacheClear();
 
   // root has no directory entry
   dirBlock_ = 0;
@@ -833,6 +879,49 @@ int16_t SdFile::read(void* buf, uint16_t nbyte) {
   return nbyte;
 }
 //------------------------------------------------------------------------------
+/**
+   Read to the end of the current block of a file for sending it on.
+
+   Whole blocks are read with a multiple block read that stays open on the
+   card, so a file whose clusters are consecutive streams without a command
+   per block.  A position that is not block aligned, the last part block
+   and directories fall back to read().  Any other access to the card ends
+   the multiple block read.
+
+   \param[out] dst Pointer to a 512 byte buffer for the data.
+
+   \return The number of bytes read, zero at end of file or -1 if an
+   error occurred.
+*/
+int16_t SdFile::readStream(uint8_t* dst) {
+  uint16_t offset = curPosition_ & 0X1FF;
+  uint16_t n = 512 - offset;
+  if (n > (fileSize_ - curPosition_)) {
+    n = fileSize_ - curPosition_;
+  }
+  if (!isFile() || !(flags_ & O_READ) || n != 512) {
+    return read(dst, n);
+  }
+  uint8_t blockOfCluster = vol_->blockOfCluster(curPosition_);
+  if (blockOfCluster == 0) {
+    // start of new cluster
+    if (curPosition_ == 0) {
+      curCluster_ = firstCluster_;
+    } else if (!vol_->fatGet(curCluster_, &curCluster_)) {
+      return -1;
+    }
+  }
+  uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
+  if (block == SdVolume::cacheBlockNumber_) {
+    // the cache may hold data not yet written to the card
+    memcpy(dst, SdVolume::cacheBuffer_.data, 512);
+  } else if (!vol_->readStream(block, dst)) {
+    return -1;
+  }
+  curPosition_ += 512;
+  return 512;
+}
+//------------------------------------------------------------------------------
 /**
    Read the next directory entry from a directory file.
 
@@ -1105,19 +1194,80 @@ uint8_t SdFile::seekSet(uint32_t pos) {
   if (nNew < nCur || curPosition_ == 0) {
     // must follow chain from first cluster
     curCluster_ = firstCluster_;
-  } else {
-    // advance from curPosition
-    nNew -= nCur;
+    nCur = 0;
+  }
+  #if SEEK_CHECKPOINTS
+  // double the checkpoint spacing until nNew is covered
+  while ((nNew >> seekShift_) > SEEK_CHECKPOINTS) {
+    for (uint8_t i = 0; i < SEEK_CHECKPOINTS; i++) {
+      seekCluster_[i] = 2 * i + 1 < SEEK_CHECKPOINTS ? seekCluster_[2 * i + 1] : 0;
+    }
+    seekShift_++;
+  }
+  // start from the last checkpoint before nNew if it is ahead of nCur
+  for (uint8_t i = nNew >> seekShift_; i > 0; i--) {
+    uint32_t n = (uint32_t)i << seekShift_;
+    if (n <= nCur) {
+      break;
+    }
+    if (seekCluster_[i - 1]) {
+      curCluster_ = seekCluster_[i - 1];
+      nCur = n;
+      break;
+    }
   }
-  while (nNew--) {
+  #endif  // SEEK_CHECKPOINTS
+  while (nCur < nNew) {
     if (!vol_->fatGet(curCluster_, &curCluster_)) {
       return false;
     }
+    nCur++;
+    #if SEEK_CHECKPOINTS
+    // record checkpoints passed on the way
+    if ((nCur & ((1UL << seekShift_) - 1)) == 0 &&
+        (nCur >> seekShift_) <= SEEK_CHECKPOINTS) {
+      seekCluster_[(nCur >> seekShift_) - 1] = curCluster_;
+    }
+    #endif  // SEEK_CHECKPOINTS
   }
   curPosition_ = pos;
   return true;
 }
 //------------------------------------------------------------------------------
+/**
+   Set the file size to any length within its allocated clusters and write
+   it to the directory entry.
+
+   Unlike truncate() no clusters are freed, and the size may grow: this is
+   for crash recovery, which reads past the old size to find the end of
+   the valid data and then records it.
+
+   \param[in] size New size in bytes, at most allocatedSize().
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+   Reasons for failure include a file not open for write, a size beyond
+   the cluster chain or an I/O error.
+*/
+uint8_t SdFile::setRecoveredSize(uint32_t size) {
+  if (!isFile() || !(flags_ & O_WRITE)) {
+    return false;
+  }
+
+  uint32_t allocated;
+  if (!allocatedSize(&allocated) || size > allocated) {
+    return false;
+  }
+
+  fileSize_ = size;
+  if (curPosition_ > size && !seekSet(size)) {
+    return false;
+  }
+
+  flags_ |= F_FILE_DIR_DIRTY;
+  return sync();
+}
+//------------------------------------------------------------------------------
 /**
    The sync() call causes all modified data and directory fields
    to be written to the storage device.
@@ -1161,6 +1311,8 @@ uint8_t SdFile::sync(uint8_t blocking) {
 
   if (!blocking) {
     flags_ &= ~F_FILE_NON_BLOCKING_WRITE;
+  } else if (!vol_->fsInfoSync()) {
+    return false;
   }
 
   return SdVolume::cacheFlush(blocking);
@@ -1300,6 +1452,9 @@ uint8_t SdFile::truncate(uint32_t length) {
   }
   fileSize_ = length;
 
+  // checkpoints may point into the freed part of the chain
+  seekCacheClear();
+
   // need to update directory entry
   flags_ |= F_FILE_DIR_DIRTY;
 
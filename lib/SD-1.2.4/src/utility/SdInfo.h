@@ -42,8 +42,12 @@ uint8_t const CMD9 = 0X09;
 uint8_t const CMD10 = 0X0A;
 /** SEND_STATUS - read the card status register */
 uint8_t const CMD13 = 0X0D;
+/** STOP_TRANSMISSION - end multiple block read sequence */
+uint8_t const CMD12 = 0X0C;
 /** READ_BLOCK - read a single data block from the card */
 uint8_t const CMD17 = 0X11;
+/** READ_MULTIPLE_BLOCK - read blocks of data until a STOP_TRANSMISSION */
+uint8_t const CMD18 = 0X12;
 /** WRITE_BLOCK - write a single data block to the card */
 uint8_t const CMD24 = 0X18;
 /** WRITE_MULTIPLE_BLOCK - write blocks of data until a STOP_TRANSMISSION */
@@ -42,6 +42,20 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
 
     // don't save new start location
     setStart = false;
+
+    // clusters below allocSearchStart_ are in use, so when the next
+    // cluster is taken go straight to the hint rather than scanning
+    // the clusters of every file written since this one
+    if (count == 1 && bgnCluster < allocSearchStart_) {
+      uint32_t f;
+      if (!fatGet(bgnCluster, &f)) {
+        return false;
+      }
+      if (f != 0) {
+        bgnCluster = allocSearchStart_;
+        setStart = true;
+      }
+    }
   } else {
     // start at likely place for free cluster
     bgnCluster = allocSearchStart_;
@@ -83,6 +97,7 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   if (!fatPutEOC(endCluster)) {
     return false;
   }
+  freeCountAdjust(endCluster, -1);
 
   // link clusters
   while (endCluster > bgnCluster) {
@@ -90,6 +105,7 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
       return false;
     }
     endCluster--;
+    freeCountAdjust(endCluster, -1);
   }
   if (*curCluster != 0) {
     // connect chains
@@ -103,6 +119,7 @@ uint8_t SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
   // remember possible next free cluster
   if (setStart) {
     allocSearchStart_ = bgnCluster + 1;
+    fsInfoDirty_ = fsInfoBlock_ != 0;
   }
 
   return true;
@@ -237,9 +254,6 @@ uint8_t SdVolume::fatPut(uint32_t cluster, uint32_t value) {
 //------------------------------------------------------------------------------
 // free a cluster chain
 uint8_t SdVolume::freeChain(uint32_t cluster) {
-  // clear free cluster location
-  allocSearchStart_ = 2;
-
   do {
     uint32_t next;
     if (!fatGet(cluster, &next)) {
@@ -250,6 +264,12 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
     if (!fatPut(cluster, 0)) {
       return false;
     }
+    freeCountAdjust(cluster, 1);
+
+    // keep the search start at or below the lowest free cluster
+    if (cluster < allocSearchStart_) {
+      allocSearchStart_ = cluster;
+    }
 
     cluster = next;
   } while (!isEOC(cluster));
@@ -257,6 +277,100 @@ uint8_t SdVolume::freeChain(uint32_t cluster) {
   return true;
 }
 //------------------------------------------------------------------------------
+// account for a cluster that was allocated (delta -1) or freed (delta 1)
+void SdVolume::freeCountAdjust(uint32_t cluster, int8_t delta) {
+  if (freeClusters_ != FSINFO_UNKNOWN) {
+    freeClusters_ += delta;
+    fsInfoDirty_ = fsInfoBlock_ != 0;
+  }
+  if (!freeCountExact_ && cluster < scanCluster_) {
+    // already counted by freeClusterScan()
+    scanFree_ += delta;
+  }
+}
+//------------------------------------------------------------------------------
+/**
+   Count free clusters a few FAT blocks at a time.
+
+   Call repeatedly until freeClusterCountExact() is true.  A count taken
+   from FSINFO is only a hint (it is stale if the card was not unmounted
+   cleanly), so the scan runs on FAT32 too and replaces it when done.
+   Clusters allocated or freed while the scan is running are accounted
+   for, so the count is exact once the last FAT block has been read.  Each
+   call reads at most \a maxBlocks FAT blocks through the volume cache.
+
+   \param[in] maxBlocks FAT blocks to read in this call.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t SdVolume::freeClusterScan(uint16_t maxBlocks) {
+  if (freeCountExact_) {
+    return true;
+  }
+  if (scanCluster_ == 0) {
+    scanCluster_ = 2;
+    scanFree_ = 0;
+  }
+  // entries in one FAT block
+  uint16_t perBlock = fatType_ == 16 ? 256 : 128;
+  uint32_t fatEnd = clusterCount_ + 2;
+
+  while (maxBlocks-- && scanCluster_ < fatEnd) {
+    uint32_t lba = fatStartBlock_;
+    lba += fatType_ == 16 ? scanCluster_ >> 8 : scanCluster_ >> 7;
+    if (!cacheRawBlock(lba, CACHE_FOR_READ)) {
+      return false;
+    }
+    // the first two entries and those past the last cluster are not free
+    uint16_t i = scanCluster_ & (perBlock - 1);
+    uint16_t n = fatEnd - scanCluster_ < (uint32_t)(perBlock - i) ?
+                 fatEnd - scanCluster_ : perBlock - i;
+    scanCluster_ += n;
+    if (fatType_ == 16) {
+      for (n += i; i < n; i++) {
+        if (cacheBuffer_.fat16[i] == 0) {
+          scanFree_++;
+        }
+      }
+    } else {
+      for (n += i; i < n; i++) {
+        if ((cacheBuffer_.fat32[i] & FAT32MASK) == 0) {
+          scanFree_++;
+        }
+      }
+    }
+  }
+  if (scanCluster_ >= fatEnd) {
+    freeClusters_ = scanFree_;
+    freeCountExact_ = true;
+    scanCluster_ = 0;
+    fsInfoDirty_ = fsInfoBlock_ != 0;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+/**
+   Write the free cluster count and next free cluster hint to the FSINFO
+   sector of a FAT32 volume if they have changed.  SdFile::sync() calls
+   this; it does nothing on FAT16.
+
+   \return The value one, true, is returned for success and
+   the value zero, false, is returned for failure.
+*/
+uint8_t SdVolume::fsInfoSync(void) {
+  if (!fsInfoDirty_) {
+    return true;
+  }
+  if (!cacheRawBlock(fsInfoBlock_, CACHE_FOR_WRITE)) {
+    return false;
+  }
+  cacheBuffer_.fsinfo.freeCount = freeClusters_;
+  cacheBuffer_.fsinfo.nextFree = allocSearchStart_;
+  fsInfoDirty_ = 0;
+  return true;
+}
+//------------------------------------------------------------------------------
 /**
    Initialize a FAT volume.
 
@@ -347,5 +461,32 @@ uint8_t SdVolume::init(Sd2Card* dev, uint8_t part) {
     rootDirStart_ = bpb->fat32RootCluster;
     fatType_ = 32;
   }
+
+  // free space is unknown until FSINFO hints at it, and only exact once
+  // freeClusterScan() has counted it
+  allocSearchStart_ = 2;
+  freeClusters_ = FSINFO_UNKNOWN;
+  freeCountExact_ = false;
+  fsInfoBlock_ = 0;
+  fsInfoDirty_ = 0;
+  scanCluster_ = 0;
+  if (fatType_ == 32 && bpb->fat32FSInfo) {
+    uint32_t block = volumeStartBlock + bpb->fat32FSInfo;
+    if (!cacheRawBlock(block, CACHE_FOR_READ)) {
+      return false;
+    }
+    fsinfo_t* fsi = &cacheBuffer_.fsinfo;
+    if (fsi->leadSignature == FSINFO_LEAD_SIG &&
+        fsi->structSignature == FSINFO_STRUCT_SIG &&
+        fsi->tailSignature == FSINFO_TRAIL_SIG) {
+      fsInfoBlock_ = block;
+      if (fsi->freeCount <= clusterCount_) {
+        freeClusters_ = fsi->freeCount;
+      }
+      if (fsi->nextFree >= 2 && fsi->nextFree <= clusterCount_ + 1) {
+        allocSearchStart_ = fsi->nextFree;
+      }
+    }
+  }
   return true;
 }
@@ -0,0 +1,213 @@
+#include "Bmp280.h"
+
+#ifdef ARDUINO
+#include <Wire.h>
+#endif
+
+// registers
+#define REG_CALIB_TP 0x88
+#define REG_CALIB_H1 0xA1
+#define REG_ID 0xD0
+#define REG_CALIB_H2 0xE1
+#define REG_CTRL_HUM 0xF2
+#define REG_STATUS 0xF3
+#define REG_CTRL_MEAS 0xF4
+#define REG_CONFIG 0xF5
+#define REG_DATA 0xF7
+
+#define STATUS_MEASURING 0x08
+
+#define MODE_SLEEP 0x00
+#define MODE_FORCED 0x01
+
+#ifdef ARDUINO
+void WireBmp280Bus::begin()
+{
+    Wire.begin();
+}
+
+bool WireBmp280Bus::writeRegister(uint8_t addr, uint8_t reg, uint8_t value)
+{
+    Wire.beginTransmission(addr);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+bool WireBmp280Bus::readRegisters(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len)
+{
+    Wire.beginTransmission(addr);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0)
+        return false;
+
+    if (Wire.requestFrom(addr, len) != len)
+        return false;
+
+    for (uint8_t i = 0; i < len; i++)
+        buf[i] = Wire.read();
+    return true;
+}
+#endif
+
+static inline uint16_t le16(const uint8_t* p)
+{
+    return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+bool Bmp280::begin(Bmp280Bus* bus, uint8_t addr)
+{
+    bus_ = bus;
+    addr_ = addr;
+    chipId_ = 0;
+    triggered_ = false;
+
+    uint8_t id;
+    if (!bus_->readRegisters(addr_, REG_ID, &id, 1))
+        return false;
+    if (id != BMP280_CHIP_ID && id != BME280_CHIP_ID)
+        return false;
+
+    chipId_ = id;
+    if (!readCalibration())
+    {
+        chipId_ = 0;
+        return false;
+    }
+
+    configure(BMP280_OSRS_X1, BMP280_OSRS_X1, BMP280_OSRS_X1, BMP280_FILTER_OFF);
+    return true;
+}
+
+bool Bmp280::readCalibration()
+{
+    uint8_t c[24];
+    if (!bus_->readRegisters(addr_, REG_CALIB_TP, c, sizeof(c)))
+        return false;
+
+    digT1_ = le16(c + 0);
+    digT2_ = le16(c + 2);
+    digT3_ = le16(c + 4);
+    digP1_ = le16(c + 6);
+    digP2_ = le16(c + 8);
+    digP3_ = le16(c + 10);
+    digP4_ = le16(c + 12);
+    digP5_ = le16(c + 14);
+    digP6_ = le16(c + 16);
+    digP7_ = le16(c + 18);
+    digP8_ = le16(c + 20);
+    digP9_ = le16(c + 22);
+
+    if (!hasHumidity())
+        return true;
+
+    uint8_t h[7];
+    if (!bus_->readRegisters(addr_, REG_CALIB_H1, &digH1_, 1))
+        return false;
+    if (!bus_->readRegisters(addr_, REG_CALIB_H2, h, sizeof(h)))
+        return false;
+
+    digH2_ = le16(h + 0);
+    digH3_ = h[2];
+    digH4_ = ((int16_t)(int8_t)h[3] << 4) | (h[4] & 0x0F);
+    digH5_ = ((int16_t)(int8_t)h[5] << 4) | (h[4] >> 4);
+    digH6_ = (int8_t)h[6];
+    return true;
+}
+
+void Bmp280::configure(uint8_t osrsT, uint8_t osrsP, uint8_t osrsH, uint8_t filter)
+{
+    if (!present())
+        return;
+
+    // Config is only guaranteed to be written in sleep mode, and ctrl_hum
+    // only takes effect after the following ctrl_meas write
+    bus_->writeRegister(addr_, REG_CTRL_MEAS, MODE_SLEEP);
+    bus_->writeRegister(addr_, REG_CONFIG, (filter & 0x07) << 2);
+    if (hasHumidity())
+        bus_->writeRegister(addr_, REG_CTRL_HUM, osrsH & 0x07);
+
+    ctrlMeas_ = ((osrsT & 0x07) << 5) | ((osrsP & 0x07) << 2);
+    bus_->writeRegister(addr_, REG_CTRL_MEAS, ctrlMeas_ | MODE_SLEEP);
+    triggered_ = false;
+}
+
+bool Bmp280::trigger()
+{
+    if (!present())
+        return false;
+
+    triggered_ = bus_->writeRegister(addr_, REG_CTRL_MEAS, ctrlMeas_ | MODE_FORCED);
+    return triggered_;
+}
+
+bool Bmp280::read(Bmp280Sample* sample)
+{
+    if (!present() || !triggered_)
+        return false;
+
+    uint8_t status;
+    if (!bus_->readRegisters(addr_, REG_STATUS, &status, 1) || (status & STATUS_MEASURING))
+        return false;
+
+    // press_msb..temp_xlsb (+ hum_msb, hum_lsb on the BME280) in one burst
+    uint8_t d[8];
+    uint8_t len = hasHumidity() ? 8 : 6;
+    if (!bus_->readRegisters(addr_, REG_DATA, d, len))
+        return false;
+
+    triggered_ = false;
+
+    int32_t adcP = ((uint32_t)d[0] << 12) | ((uint32_t)d[1] << 4) | (d[2] >> 4);
+    int32_t adcT = ((uint32_t)d[3] << 12) | ((uint32_t)d[4] << 4) | (d[5] >> 4);
+
+    int32_t tFine;
+    sample->temperature = compensateT(adcT, &tFine);
+    sample->pressure = compensateP(adcP, tFine);
+    sample->humidity = hasHumidity() ? compensateH(((int32_t)d[6] << 8) | d[7], tFine) : 0;
+    return true;
+}
+
+// The compensation routines below follow the Bosch BME280 datasheet
+// (section 4.2.3) integer reference code.
+
+int32_t Bmp280::compensateT(int32_t adcT, int32_t* tFine) const
+{
+    int32_t var1 = ((((adcT >> 3) - ((int32_t)digT1_ << 1))) * ((int32_t)digT2_)) >> 11;
+    int32_t var2 = (((((adcT >> 4) - ((int32_t)digT1_)) * ((adcT >> 4) - ((int32_t)digT1_))) >> 12) *
+                    ((int32_t)digT3_)) >> 14;
+    *tFine = var1 + var2;
+    return (*tFine * 5 + 128) >> 8;
+}
+
+uint32_t Bmp280::compensateP(int32_t adcP, int32_t tFine) const
+{
+    int64_t var1 = ((int64_t)tFine) - 128000;
+    int64_t var2 = var1 * var1 * (int64_t)digP6_;
+    var2 = var2 + ((var1 * (int64_t)digP5_) << 17);
+    var2 = var2 + (((int64_t)digP4_) << 35);
+    var1 = ((var1 * var1 * (int64_t)digP3_) >> 8) + ((var1 * (int64_t)digP2_) << 12);
+    var1 = (((((int64_t)1) << 47) + var1)) * ((int64_t)digP1_) >> 33;
+    if (var1 == 0)
+        return 0;   // avoid division by zero
+
+    int64_t p = 1048576 - adcP;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)digP9_) * (p >> 13) * (p >> 13)) >> 25;
+    var2 = (((int64_t)digP8_) * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + (((int64_t)digP7_) << 4);
+    return (uint32_t)p;
+}
+
+uint32_t Bmp280::compensateH(int32_t adcH, int32_t tFine) const
+{
+    int32_t v = tFine - ((int32_t)76800);
+    v = (((((adcH << 14) - (((int32_t)digH4_) << 20) - (((int32_t)digH5_) * v)) +
+           ((int32_t)16384)) >> 15) *
+         (((((((v * ((int32_t)digH6_)) >> 10) * (((v * ((int32_t)digH3_)) >> 11) +
+              ((int32_t)32768))) >> 10) + ((int32_t)2097152)) * ((int32_t)digH2_) + 8192) >> 14));
+    v = (v - (((((v >> 15) * (v >> 15)) >> 7) * ((int32_t)digH1_)) >> 4));
+    v = (v < 0 ? 0 : v);
+    v = (v > 419430400 ? 419430400 : v);
+    return (uint32_t)(v >> 12);
+}
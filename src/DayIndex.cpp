@@ -0,0 +1,236 @@
+#include "DayIndex.h"
+
+#include <SD.h>
+#include <TimeLib.h>
+
+#define DAY_INDEX_NAME(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    static const char dayIndexName_##Name[] PROGMEM = #Name;
+#define DAY_INDEX_NAME_PTR(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    dayIndexName_##Name,
+#define DAY_INDEX_DECIMALS(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    Decimals,
+
+#define DAY_INDEX_STREAM_NAMES(Type, File, Id, Fields, LogMs) Fields(DAY_INDEX_NAME)
+#define DAY_INDEX_STREAM_NAME_PTRS(Type, File, Id, Fields, LogMs) Fields(DAY_INDEX_NAME_PTR)
+#define DAY_INDEX_STREAM_DECIMALS(Type, File, Id, Fields, LogMs) Fields(DAY_INDEX_DECIMALS)
+
+LOG_STREAMS(DAY_INDEX_STREAM_NAMES)
+
+static const char* const channelNames[LOG_CHANNEL_COUNT] PROGMEM = {
+    LOG_STREAMS(DAY_INDEX_STREAM_NAME_PTRS)
+};
+
+static const uint8_t channelDecimals[LOG_CHANNEL_COUNT] PROGMEM = {
+    LOG_STREAMS(DAY_INDEX_STREAM_DECIMALS)
+};
+
+static uint16_t dayYear(uint16_t day)
+{
+    return year((time_t)day * SECS_PER_DAY);
+}
+
+static void indexPath(char* path, uint8_t size, uint16_t year)
+{
+    snprintf_P(path, size, PSTR("/LOGS/%u/" DAY_INDEX_FILE), year);
+}
+
+// false for a file that has none yet, or one of an older schema
+static bool readHeader(File& f, DayIndexHeader* header)
+{
+    return f.read(header, sizeof(*header)) == (int)sizeof(*header) &&
+           header->entrySize == sizeof(DayIndexEntry);
+}
+
+static uint32_t slotOffset(const DayIndexHeader& header, uint16_t day)
+{
+    return sizeof(header) + (uint32_t)(day - header.firstDay) * sizeof(DayIndexEntry);
+}
+
+void DayIndex::add(uint32_t time, uint8_t firstChannel, const int32_t* values, uint8_t count)
+{
+    uint16_t day = time / SECS_PER_DAY;
+    if (day < DAY_INDEX_FIRST_DAY)
+        return;     // clock not set yet
+
+    if (day != today_.day)
+    {
+        if (today_.day)
+            save();
+        load(day);
+        lastSave_ = time;
+    }
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        int32_t v = values[i];
+        if (v == LOG_MISSING)
+            continue;
+
+        uint8_t ch = firstChannel + i;
+        uint16_t bit = 1U << ch;
+        if (!(today_.channels & bit) || v < today_.min[ch])
+            today_.min[ch] = v;
+        if (!(today_.channels & bit) || v > today_.max[ch])
+            today_.max[ch] = v;
+        today_.channels |= bit;
+    }
+
+    if (time - lastSave_ >= DAY_INDEX_SAVE_S)
+    {
+        save();
+        lastSave_ = time;
+    }
+}
+
+void DayIndex::load(uint16_t day)
+{
+    // Continue a day already in the file, e.g. after a reset
+    char path[24];
+    indexPath(path, sizeof(path), dayYear(day));
+    File f = SD.open(path, O_READ);
+    if (f)
+    {
+        DayIndexHeader header;
+        bool found = readHeader(f, &header) && day >= header.firstDay &&
+                     f.seek(slotOffset(header, day)) &&
+                     f.read(&today_, sizeof(today_)) == (int)sizeof(today_) &&
+                     today_.day == day;
+        f.close();
+        if (found)
+            return;
+    }
+
+    memset(&today_, 0, sizeof(today_));
+    today_.day = day;
+}
+
+bool DayIndex::save()
+{
+    if (!today_.day)
+        return false;
+
+    char path[24];
+    indexPath(path, sizeof(path), dayYear(today_.day));
+    File f = SD.open(path, O_READ | O_WRITE | O_CREAT);
+    if (!f)
+        return false;
+
+    DayIndexHeader header;
+    if (!readHeader(f, &header))
+    {
+        // The year's first day with logs, or a file of an older schema
+        // that is started over
+        f.close();
+        f = SD.open(path, O_READ | O_WRITE | O_CREAT | O_TRUNC);
+        header.firstDay = today_.day;
+        header.entrySize = sizeof(DayIndexEntry);
+        if (!f || f.write((const uint8_t*)&header, sizeof(header)) != sizeof(header))
+        {
+            if (f)
+                f.close();
+            return false;
+        }
+    }
+    else if (today_.day < header.firstDay)
+    {
+        // The clock went back past the start of the file
+        f.close();
+        return false;
+    }
+
+    // Days without logs before this one become empty slots
+    uint32_t offset = slotOffset(header, today_.day);
+    uint32_t size = f.size();
+    if (size < offset)
+    {
+        DayIndexEntry empty;
+        memset(&empty, 0, sizeof(empty));
+        f.seek(size - (size - sizeof(header)) % sizeof(empty));
+        while (f.position() < offset)
+            f.write((const uint8_t*)&empty, sizeof(empty));
+    }
+
+    bool ok = f.seek(offset) &&
+              f.write((const uint8_t*)&today_, sizeof(today_)) == sizeof(today_);
+    f.close();
+    return ok;
+}
+
+void DayIndex::printEntry(Print& out, const DayIndexEntry& e, bool first)
+{
+    if (!first)
+        out.print(',');
+
+    tmElements_t tm;
+    breakTime((time_t)e.day * SECS_PER_DAY, tm);
+    char date[12];
+    snprintf_P(date, sizeof(date), PSTR("%04u-%02u-%02u"), tmYearToCalendar(tm.Year), tm.Month, tm.Day);
+
+    out.print(F("\n{\"date\":\""));
+    out.print(date);
+    out.print(F("\",\"bytes\":"));
+    out.print(e.dataBytes);
+
+    for (uint8_t ch = 0; ch < LOG_CHANNEL_COUNT; ch++)
+    {
+        if (!(e.channels & (1U << ch)))
+            continue;
+
+        uint8_t decimals = pgm_read_byte(&channelDecimals[ch]);
+        out.print(F(",\""));
+        out.print(reinterpret_cast<const __FlashStringHelper*>(pgm_read_ptr(&channelNames[ch])));
+        out.print(F("\":["));
+        printFixed(out, e.min[ch], decimals);
+        out.print(',');
+        printFixed(out, e.max[ch], decimals);
+        out.print(']');
+    }
+    out.print('}');
+}
+
+// cursor: 0 before the opening bracket, then 1, or 2 once a day is out
+bool DayIndex::printJson(Print& out, uint16_t year, File& file, uint32_t& cursor)
+{
+    if (!year)
+        year = ::year();
+
+    if (!cursor)
+    {
+        out.print('[');
+        cursor = 1;
+        char path[24];
+        indexPath(path, sizeof(path), year);
+        DayIndexHeader header;
+        file = SD.open(path, O_READ);
+        if (file && !readHeader(file, &header))
+            file.close();
+        return true;
+    }
+
+    bool first = cursor == 1;
+    if (file)
+    {
+        DayIndexEntry e;
+        for (uint8_t i = 0; i < DAY_INDEX_SCAN_SLOTS; i++)
+        {
+            if (file.read(&e, sizeof(e)) != (int)sizeof(e))
+            {
+                file.close();
+                break;
+            }
+            // the open day is printed from RAM at the end
+            if (!e.day || e.day == today_.day)
+                continue;
+            printEntry(out, e, first);
+            cursor = 2;
+            return true;
+        }
+        if (file)
+            return true;
+    }
+
+    if (today_.day && today_.channels && dayYear(today_.day) == year)
+        printEntry(out, today_, first);
+    out.println(F("\n]"));
+    return false;
+}
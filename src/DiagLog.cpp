@@ -0,0 +1,95 @@
+#include "DiagLog.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+DiagLog diag;
+
+void DiagLog::begin(unsigned long baud)
+{
+    head_ = 0;
+    tail_ = 0;
+    pendingDrops_ = 0;
+    droppedTotal_ = 0;
+    Serial.begin(baud);
+}
+
+void DiagLog::log(char level, PGM_P format, ...)
+{
+    char line[DIAG_LINE_MAX];
+    int len = snprintf_P(line, sizeof(line), PSTR("%c %lu "), level, millis());
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf_P(line + len, sizeof(line) - len - 2, format, args);
+    va_end(args);
+
+    len = strlen(line);
+    line[len++] = '\r';
+    line[len++] = '\n';
+
+    if (pendingDrops_)
+    {
+        char note[32];
+        int n = snprintf_P(note, sizeof(note), PSTR("W %u messages dropped\r\n"), pendingDrops_);
+        if (space() < n + len)
+        {
+            pendingDrops_++;
+            droppedTotal_++;
+            return;
+        }
+        put(note, n);
+        pendingDrops_ = 0;
+    }
+
+    if (space() < len)
+    {
+        pendingDrops_++;
+        droppedTotal_++;
+        return;
+    }
+    put(line, len);
+}
+
+void DiagLog::put(const char* s, uint16_t len)
+{
+    while (len--)
+    {
+        ring_[head_] = *s++;
+        head_ = (head_ + 1) % DIAG_BUFFER_SIZE;
+    }
+}
+
+void DiagLog::drain()
+{
+    int room = Serial.availableForWrite();
+    while (room > 0 && tail_ != head_)
+    {
+        // contiguous run up to the end of the ring or the head
+        uint16_t end = head_ > tail_ ? head_ : DIAG_BUFFER_SIZE;
+        uint16_t n = end - tail_;
+        if (n > (uint16_t)room)
+            n = room;
+
+        Serial.write((const uint8_t*)ring_ + tail_, n);
+        tail_ = (tail_ + n) % DIAG_BUFFER_SIZE;
+        room -= n;
+    }
+}
+
+void DiagLog::flush()
+{
+    while (tail_ != head_)
+        drain();
+    Serial.flush();
+}
+
+size_t DiagLog::write(uint8_t c)
+{
+    while (space() == 0)
+        drain();
+
+    char ch = c;
+    put(&ch, 1);
+    return 1;
+}
@@ -0,0 +1,709 @@
+#include "HttpServer.h"
+
+#include <utility/w5100.h>
+
+#include "DiagLog.h"
+#include "PerfCounters.h"
+
+// Lines headerLine() adds after the queued ones: Content-Length or
+// Transfer-Encoding, Connection, Keep-Alive and the blank line
+#define HTTP_EXTRA_HEADERS 4
+
+void HttpConnection::header(PGM_P line)
+{
+    if (headerCount_ < HTTP_MAX_HEADERS)
+        headers_[headerCount_++] = line;
+}
+
+void HttpConnection::body(PGM_P text)
+{
+    body(text, strlen_P(text));
+}
+
+void HttpConnection::body(PGM_P data, uint32_t length)
+{
+    text_ = data;
+    length_ = length;
+}
+
+void HttpConnection::render(PGM_P data, uint32_t length, TemplateResolver resolve)
+{
+    body(data, length);
+    renderer_.begin(resolve);
+    rendering_ = true;
+    beginChunked();
+}
+
+void HttpConnection::generate(HttpGenerator gen)
+{
+    generator_ = gen;
+    beginChunked();
+}
+
+void HttpConnection::generate(HttpGenerator gen, File& file)
+{
+    file_ = file;
+    file = File();
+    generate(gen);
+}
+
+void HttpConnection::beginChunked()
+{
+    streaming_ = true;
+
+    // Without chunked encoding only the close marks the end
+    if (!http11_)
+        keepAlive_ = false;
+}
+
+void HttpConnection::notModified()
+{
+    header(PSTR("HTTP/1.1 304 Not Modified"));
+    noBody_ = true;
+}
+
+void HttpConnection::sendFile(File& file)
+{
+    length_ = file.size() - file.position();
+    file_ = file;
+    file = File();
+}
+
+void HttpConnection::open(const EthernetClient& client)
+{
+    client_ = client;
+    client_.setConnectionTimeout(HTTP_CLOSE_TIMEOUT);
+    rxPos_ = 0;
+    rxLen_ = 0;
+    requests_ = 0;
+    reset();
+}
+
+// Ready for the next request on the same connection
+void HttpConnection::reset()
+{
+    text_ = NULL;
+    generator_ = NULL;
+    cursor_ = 0;
+    length_ = 0;
+    textPos_ = 0;
+    lineLen_ = 0;
+    headerCount_ = 0;
+    headerIndex_ = 0;
+    requestDone_ = false;
+    http11_ = false;
+    keepAlive_ = false;
+    streaming_ = false;
+    rendering_ = false;
+    noBody_ = false;
+    gzip_ = false;
+    hasEtag_ = false;
+    hasBody_ = false;
+    state_ = HTTP_REQUEST;
+    lastProgress_ = millis();
+}
+
+// Takes whatever has arrived; true once the blank line after the headers is in
+bool HttpConnection::readRequest()
+{
+    PERF_SCOPE(HTTP_PARSE);
+    while (true)
+    {
+        if (rxPos_ == rxLen_)
+        {
+            int got = client_.read(rx_, sizeof(rx_));
+            if (got <= 0)
+                return false;
+            rxPos_ = 0;
+            rxLen_ = got;
+            lastProgress_ = millis();
+        }
+
+        char c = rx_[rxPos_++];
+        if (c == '\r')
+            continue;
+
+        if (c == '\n')
+        {
+            if (!requestDone_)
+            {
+                // Empty lines before a request are allowed and skipped
+                if (!lineLen_)
+                    continue;
+                line_[lineLen_] = 0;
+                requestDone_ = true;
+                http11_ = strstr_P(line_, PSTR(" HTTP/1.1")) != NULL;
+                keepAlive_ = http11_;
+            }
+            else if (!lineLen_)
+            {
+                // Request bodies are never read; closing after the
+                // response keeps one from passing for the next request
+                if (hasBody_)
+                    keepAlive_ = false;
+                return true;
+            }
+            else
+                parseField();
+            lineLen_ = 0;
+            continue;
+        }
+
+        if (!requestDone_)
+        {
+            if (lineLen_ < HTTP_LINE_MAX - 1)
+                line_[lineLen_++] = c;
+        }
+        else if (lineLen_ < HTTP_FIELD_MAX - 1)
+            field_[lineLen_++] = tolower(c);
+    }
+}
+
+// Picks up the few request headers that matter here
+void HttpConnection::parseField()
+{
+    field_[lineLen_] = 0;
+    if (strncmp_P(field_, PSTR("connection:"), 11) == 0)
+    {
+        if (strstr_P(field_ + 11, PSTR("close")))
+            keepAlive_ = false;
+        else if (strstr_P(field_ + 11, PSTR("keep-alive")))
+            keepAlive_ = true;
+    }
+    else if (strncmp_P(field_, PSTR("content-length:"), 15) == 0)
+        hasBody_ = strtoul(field_ + 15, NULL, 10) != 0;
+    else if (strncmp_P(field_, PSTR("transfer-encoding:"), 18) == 0)
+        hasBody_ = true;
+    else if (strncmp_P(field_, PSTR("accept-encoding:"), 16) == 0)
+        gzip_ = strstr_P(field_ + 16, PSTR("gzip")) != NULL;
+    else if (strncmp_P(field_, PSTR("if-none-match:"), 14) == 0)
+    {
+        // Only our own "xxxxxxxx" tags can match
+        char* quote = strchr(field_ + 14, '"');
+        if (quote)
+        {
+            etag_ = strtoul(quote + 1, NULL, 16);
+            hasEtag_ = true;
+        }
+    }
+}
+
+// Header line index with its CRLF into line; 0 if the line is left out
+uint8_t HttpConnection::headerLine(uint8_t index, char* line)
+{
+    int len;
+    if (index < headerCount_)
+    {
+        strncpy_P(line, headers_[index], HTTP_LINE_MAX - 2);
+        line[HTTP_LINE_MAX - 3] = 0;
+        len = strlen(line);
+    }
+    else if (index == headerCount_)
+    {
+        // An event stream ends with the connection
+        if (noBody_ || state_ == HTTP_EVENTS)
+            return 0;
+        if (!streaming_)
+            len = snprintf_P(line, HTTP_LINE_MAX, PSTR("Content-Length: %lu"), length_);
+        else if (http11_)
+            len = snprintf_P(line, HTTP_LINE_MAX, PSTR("Transfer-Encoding: chunked"));
+        else
+            return 0;
+    }
+    else if (index == headerCount_ + 1)
+        len = snprintf_P(line, HTTP_LINE_MAX, keepAlive_ ? PSTR("Connection: keep-alive") : PSTR("Connection: close"));
+    else if (index == headerCount_ + 2)
+    {
+        if (!keepAlive_)
+            return 0;
+        len = snprintf_P(line, HTTP_LINE_MAX, PSTR("Keep-Alive: timeout=%u, max=%u"),
+                         HTTP_IDLE_TIMEOUT / 1000, HTTP_MAX_REQUESTS - requests_);
+    }
+    else
+        len = 0;
+
+    line[len++] = '\r';
+    line[len++] = '\n';
+    return len;
+}
+
+// Writes what the TX buffer has room for; true if anything went out
+bool HttpConnection::pump()
+{
+    bool wrote = false;
+
+    while (headerCount_ && headerIndex_ < headerCount_ + HTTP_EXTRA_HEADERS)
+    {
+        char line[HTTP_LINE_MAX];
+        uint8_t len = headerLine(headerIndex_, line);
+        if (len)
+        {
+            if (client_.availableForWrite() < len)
+                return wrote;
+            client_.write((const uint8_t*)line, len);
+            lastProgress_ = millis();
+            wrote = true;
+        }
+        headerIndex_++;
+    }
+
+    static_assert(HTTP_PART_ROOM <= 2048, "a part must fit the socket's TX buffer");
+    while (rendering_ && text_)
+    {
+        if (client_.availableForWrite() < HTTP_PART_ROOM)
+            return wrote;
+
+        uint8_t piece[HTTP_TEMPLATE_PIECE];
+        uint16_t len = length_ - textPos_;
+        if (len > sizeof(piece))
+            len = sizeof(piece);
+        memcpy_P(piece, text_ + textPos_, len);
+        textPos_ += len;
+
+        // Each piece leaves as its own chunks; the renderer keeps a
+        // placeholder cut at the end of the piece for the next one
+        ChunkedWriter out(*this);
+        renderer_.write(piece, len, out);
+        if (textPos_ < length_)
+            out.suspend();
+        else
+        {
+            renderer_.end(out);
+            text_ = NULL;
+        }
+        wrote = true;
+    }
+
+    while (text_ && textPos_ < length_)
+    {
+        int room = client_.availableForWrite();
+        if (room <= 0)
+            return wrote;
+
+        // Straight from flash in as large pieces as the socket takes
+        uint8_t buf[HTTP_CHUNK];
+        uint16_t len = length_ - textPos_;
+        if (len > sizeof(buf))
+            len = sizeof(buf);
+        if (len > room)
+            len = room;
+        memcpy_P(buf, text_ + textPos_, len);
+        client_.write(buf, len);
+        textPos_ += len;
+        lastProgress_ = millis();
+        wrote = true;
+    }
+    text_ = NULL;
+
+    while (generator_)
+    {
+        if (client_.availableForWrite() < HTTP_PART_ROOM)
+            return wrote;
+
+        ChunkedWriter out(*this);
+        if (generator_(*this, out))
+            out.suspend();
+        else
+        {
+            out.end();
+            generator_ = NULL;
+            if (file_)
+                file_.close();
+        }
+        wrote = true;
+    }
+
+    static_assert(HTTP_CHUNK % 512 == 0, "HTTP_CHUNK must be whole blocks");
+    while (file_)
+    {
+        if (client_.availableForWrite() < HTTP_CHUNK)
+            return wrote;
+
+        uint8_t buf[HTTP_CHUNK];
+        int len = 0;
+        {
+            PERF_SCOPE(SD_READ);
+            // readStream() fills up to a whole block
+            while (len + 512 <= HTTP_CHUNK)
+            {
+                int got = file_.readStream(buf + len);
+                if (got <= 0)
+                    break;
+                len += got;
+            }
+        }
+        if (len <= 0)
+        {
+            file_.close();
+            break;
+        }
+        client_.write(buf, len);
+        lastProgress_ = millis();
+        wrote = true;
+    }
+    return wrote;
+}
+
+// One event to an event stream; false if the client is so far behind
+// that it does not fit
+bool HttpConnection::sendEvent(const uint8_t* data, uint8_t len)
+{
+    if (client_.availableForWrite() < len)
+        return false;
+    client_.write(data, len);
+    lastProgress_ = millis();
+    return true;
+}
+
+// Keeps an event stream going between events; false once the peer is gone
+bool HttpConnection::watchEvents()
+{
+    // Nothing is expected from the viewer; whatever comes is dropped, or
+    // a close behind it would go unnoticed
+    while (client_.read(rx_, sizeof(rx_)) > 0)
+        ;
+    if (!client_.connected())
+        return false;
+
+    // A comment line, ignored by the browser. Without room for it the
+    // next event finds the stream stalled
+    if (millis() - lastProgress_ >= HTTP_EVENT_HEARTBEAT)
+        sendEvent((const uint8_t*)":\n\n", 3);
+    return true;
+}
+
+bool HttpConnection::sent()
+{
+    return (!headerCount_ || headerIndex_ >= headerCount_ + HTTP_EXTRA_HEADERS) &&
+           !text_ && !generator_ && !file_;
+}
+
+void HttpConnection::close()
+{
+    if (file_)
+        file_.close();
+    client_.stop();
+    state_ = HTTP_FREE;
+}
+
+ChunkedWriter::ChunkedWriter(HttpConnection& conn) : conn_(conn), len_(0), ended_(false)
+{
+}
+
+size_t ChunkedWriter::write(uint8_t c)
+{
+    if (len_ == HTTP_CHUNKED_BUF)
+        flush();
+    buf_[5 + len_++] = c;
+    return 1;
+}
+
+size_t ChunkedWriter::write(const uint8_t* buf, size_t size)
+{
+    size_t left = size;
+    while (left)
+    {
+        if (len_ == HTTP_CHUNKED_BUF)
+            flush();
+        size_t n = HTTP_CHUNKED_BUF - len_;
+        if (n > left)
+            n = left;
+        memcpy(buf_ + 5 + len_, buf, n);
+        len_ += n;
+        buf += n;
+        left -= n;
+    }
+    return size;
+}
+
+// One chunk: hex size line, data and CRLF in a single socket write
+void ChunkedWriter::flush()
+{
+    if (!len_)
+        return;
+
+    uint8_t* start = buf_ + 5;
+    uint16_t size = len_;
+    if (conn_.http11_)
+    {
+        static const char hex[] PROGMEM = "0123456789abcdef";
+        *--start = '\n';
+        *--start = '\r';
+        for (uint16_t n = len_; n; n >>= 4)
+            *--start = pgm_read_byte(&hex[n & 0xF]);
+        buf_[5 + len_] = '\r';
+        buf_[5 + len_ + 1] = '\n';
+        size = buf_ + 5 + len_ + 2 - start;
+    }
+    conn_.client_.write(start, size);
+    conn_.lastProgress_ = millis();
+    len_ = 0;
+}
+
+void ChunkedWriter::suspend()
+{
+    flush();
+    ended_ = true;
+}
+
+void ChunkedWriter::end()
+{
+    if (ended_)
+        return;
+    ended_ = true;
+
+    flush();
+    if (conn_.http11_)
+        conn_.client_.write((const uint8_t*)"0\r\n\r\n", 5);
+}
+
+// One event gathered in RAM, so each stream gets it in a single write
+struct EventBuffer : public Print
+{
+    uint8_t data[HTTP_EVENT_MAX];
+    uint8_t len;
+    bool overflow;
+
+    EventBuffer(HttpEventPrinter print) : len(0), overflow(false)
+    {
+        Print::print(F("data: "));
+        print(*this);
+        Print::print(F("\n\n"));
+    }
+
+    size_t write(uint8_t c) override
+    {
+        if (len == sizeof(data))
+        {
+            overflow = true;
+            return 0;
+        }
+        data[len++] = c;
+        return 1;
+    }
+    using Print::write;
+};
+
+bool HttpServer::poll()
+{
+    bool more = false;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+    {
+        HttpConnection& c = conns_[i];
+        if (c.state_ == HTTP_FREE)
+        {
+            EthernetClient client = server_.accept();
+            if (!client)
+                continue;
+            c.open(client);
+            stats_.accepted++;
+        }
+
+        if (c.state_ == HTTP_REQUEST)
+        {
+            if (!c.client_.connected() && c.rxPos_ == c.rxLen_)
+            {
+                c.close();
+                continue;
+            }
+            if (c.readRequest())
+            {
+                countRequest();
+                if (c.requests_++)
+                    stats_.reused++;
+                if (c.requests_ >= HTTP_MAX_REQUESTS)
+                    c.keepAlive_ = false;
+
+                PERF_SCOPE(HTTP_SERVE);
+                c.state_ = HTTP_RESPONSE;
+                handler_(c);
+
+                // No response queued: nothing for the client to wait
+                // for on this connection
+                if (!c.headerCount_)
+                    c.keepAlive_ = false;
+            }
+        }
+
+        if (c.state_ == HTTP_RESPONSE)
+        {
+            // A reset peer leaves no room to write and would only time out
+            if (c.client_.status() == SnSR::CLOSED)
+            {
+                c.close();
+                continue;
+            }
+
+            bool wrote;
+            {
+                PERF_SCOPE(HTTP_SERVE);
+                wrote = c.pump();
+            }
+            if (c.sent())
+            {
+                if (!c.keepAlive_)
+                {
+                    c.close();
+                    stats_.served++;
+                    continue;
+                }
+                c.reset();
+
+                // A pipelined request may already be waiting in rx_
+                more = true;
+            }
+            else if (wrote)
+                more = true;
+        }
+
+        if (c.state_ == HTTP_EVENTS)
+        {
+            if (!c.sent())
+                c.pump();
+            if (!c.watchEvents())
+            {
+                c.close();
+                stats_.served++;
+            }
+            continue;
+        }
+
+        if (c.state_ == HTTP_REQUEST && c.requests_ && !c.received())
+        {
+            if (millis() - c.lastProgress_ > HTTP_IDLE_TIMEOUT)
+            {
+                c.close();
+                stats_.served++;
+            }
+        }
+        else if (millis() - c.lastProgress_ > HTTP_TIMEOUT)
+        {
+            DIAG_WARN("HTTP client stalled, dropped");
+            c.close();
+            stats_.dropped++;
+        }
+    }
+    return more;
+}
+
+bool HttpServer::subscribe(HttpConnection& conn, HttpEventPrinter print)
+{
+    static_assert(HTTP_MAX_EVENT_STREAMS < HTTP_MAX_CONNECTIONS, "streams must leave a connection for pages");
+    if (eventStreams() >= HTTP_MAX_EVENT_STREAMS)
+    {
+        stats_.eventsRefused++;
+        return false;
+    }
+
+    // The stream has no length, so nothing can follow it on the connection
+    conn.keepAlive_ = false;
+    conn.state_ = HTTP_EVENTS;
+    conn.header(PSTR("HTTP/1.1 200 OK"));
+    conn.header(PSTR("Content-Type: text/event-stream"));
+    conn.header(PSTR("Cache-Control: no-store"));
+
+    // A fresh connection has room for the headers; should they not all go
+    // out now, poll() sends the rest and the stream starts with the next
+    // event
+    conn.pump();
+    if (print && conn.sent())
+    {
+        EventBuffer event(print);
+        if (!event.overflow && conn.sendEvent(event.data, event.len))
+            stats_.events++;
+    }
+    return true;
+}
+
+void HttpServer::publish(HttpEventPrinter print)
+{
+    if (!eventStreams())
+        return;
+
+    EventBuffer event(print);
+    if (event.overflow)
+    {
+        DIAG_WARN("Event over %u bytes, not sent", HTTP_EVENT_MAX);
+        return;
+    }
+
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+    {
+        HttpConnection& c = conns_[i];
+        if (c.state_ != HTTP_EVENTS || !c.sent())
+            continue;
+        if (c.sendEvent(event.data, event.len))
+            stats_.events++;
+        else
+        {
+            DIAG_WARN("Event stream stalled, dropped");
+            c.close();
+            stats_.dropped++;
+        }
+    }
+}
+
+uint8_t HttpServer::eventStreams() const
+{
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+        if (conns_[i].state_ == HTTP_EVENTS)
+            n++;
+    return n;
+}
+
+void HttpServer::countRequest()
+{
+    uint32_t elapsed = millis() - rateStart_;
+    if (elapsed >= 1000)
+    {
+        // After a quiet second the last full second had no requests
+        rateLast_ = elapsed < 2000 ? rateCount_ : 0;
+        rateStart_ += elapsed - elapsed % 1000;
+        rateCount_ = 0;
+    }
+
+    stats_.requests++;
+    if (++rateCount_ > stats_.rpsPeak)
+        stats_.rpsPeak = rateCount_;
+}
+
+uint16_t HttpServer::rps() const
+{
+    uint32_t elapsed = millis() - rateStart_;
+    if (elapsed >= 2000)
+        return 0;
+    return elapsed >= 1000 ? rateCount_ : rateLast_;
+}
+
+void HttpServer::printJson(Print& out) const
+{
+    uint8_t open = 0;
+    for (uint8_t i = 0; i < HTTP_MAX_CONNECTIONS; i++)
+        if (conns_[i].state_ != HTTP_FREE)
+            open++;
+
+    out.print(F("{\"open\":"));
+    out.print(open);
+    out.print(F(",\"accepted\":"));
+    out.print(stats_.accepted);
+    out.print(F(",\"requests\":"));
+    out.print(stats_.requests);
+    out.print(F(",\"reused\":"));
+    out.print(stats_.reused);
+    out.print(F(",\"served\":"));
+    out.print(stats_.served);
+    out.print(F(",\"dropped\":"));
+    out.print(stats_.dropped);
+    out.print(F(",\"streams\":"));
+    out.print(eventStreams());
+    out.print(F(",\"events\":"));
+    out.print(stats_.events);
+    out.print(F(",\"events_refused\":"));
+    out.print(stats_.eventsRefused);
+    out.print(F(",\"rps\":"));
+    out.print(rps());
+    out.print(F(",\"rps_peak\":"));
+    out.print(stats_.rpsPeak);
+    out.print('}');
+}
@@ -0,0 +1,122 @@
+#include "IdleSleep.h"
+
+#include "SpiBus.h"
+#include "WindVane.h"
+
+#include <Ethernet.h>
+#include <utility/w5100.h>
+#include <avr/sleep.h>
+
+// Interrupt mask registers enabling the per-socket interrupts
+#define W5100_IMR 0x0016
+#define W5500_SIMR 0x0018
+
+volatile bool IdleSleep::networkEvent_ = false;
+
+void IdleSleep::onNetworkInterrupt()
+{
+    networkEvent_ = true;
+}
+
+void IdleSleep::begin(uint8_t intPin)
+{
+    uint8_t chip = W5100.getChip();
+
+    spiBus.acquire(SPI_DEVICE_ETHERNET, SPI_ETHERNET_SETTINGS);
+    if (chip == 55)
+        W5100.write(W5500_SIMR, 0xFF);
+    else if (chip == 51)
+        W5100.write(W5100_IMR, 0x0F);
+    spiBus.release(SPI_DEVICE_ETHERNET);
+
+    clearNetworkInterrupts();
+
+    pinMode(intPin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(intPin), onNetworkInterrupt, FALLING);
+
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    resetStats();
+}
+
+bool IdleSleep::takeNetworkEvent()
+{
+    if (!networkEvent_)
+        return false;
+
+    networkEvent_ = false;
+    networkWakes_++;
+    return true;
+}
+
+void IdleSleep::clearNetworkInterrupts()
+{
+    spiBus.acquire(SPI_DEVICE_ETHERNET, SPI_ETHERNET_SETTINGS);
+    for (uint8_t s = 0; s < MAX_SOCK_NUM; s++)
+        W5100.writeSnIR(s, 0xFF);
+    spiBus.release(SPI_DEVICE_ETHERNET);
+}
+
+void IdleSleep::sleepFor(uint32_t ms)
+{
+    uint32_t start = millis();
+    while (millis() - start < ms)
+    {
+        uint32_t before = micros();
+        uint8_t conversions = WindVane::conversions();
+
+        // Check the flag with interrupts off; sei takes effect after the
+        // next instruction, so no wake-up can slip in before sleep_cpu()
+        cli();
+        if (networkEvent_)
+        {
+            sei();
+            break;
+        }
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+
+        sleptUs_ += micros() - before;
+        if (WindVane::conversions() != conversions)
+            adcWakes_++;
+        else
+            sleeps_++;
+    }
+}
+
+uint16_t IdleSleep::dutyCyclePermille() const
+{
+    uint32_t elapsed = micros() - windowStartUs_;
+    if (elapsed == 0 || sleptUs_ >= elapsed)
+        return 0;
+
+    return (uint16_t)(((uint64_t)(elapsed - sleptUs_) * 1000) / elapsed);
+}
+
+void IdleSleep::printStats(Print& out) const
+{
+    uint16_t duty = dutyCyclePermille();
+    out.print(F("awake "));
+    out.print(duty / 10);
+    out.print('.');
+    out.print(duty % 10);
+    out.print(F("% over "));
+    out.print((micros() - windowStartUs_) / 1000);
+    out.print(F(" ms, "));
+    out.print(sleeps_);
+    out.print(F(" sleeps (+"));
+    out.print(adcWakes_);
+    out.print(F(" vane ADC wakes), "));
+    out.print(networkWakes_);
+    out.println(F(" network wakes"));
+}
+
+void IdleSleep::resetStats()
+{
+    windowStartUs_ = micros();
+    sleptUs_ = 0;
+    sleeps_ = 0;
+    adcWakes_ = 0;
+    networkWakes_ = 0;
+}
@@ -0,0 +1,140 @@
+#include "LogQueue.h"
+
+#include <EEPROM.h>
+
+#include "LogSchema.h"
+
+uint8_t LogQueue::eepromAt(uint16_t i) const
+{
+    return EEPROM.read(EEPROM_SPILL_BASE + (eepromHead_ + i) % EEPROM_SPILL_SIZE);
+}
+
+// Size of the oldest record in each ring, 0 if it is empty; a corrupt
+// ring is dropped
+uint8_t LogQueue::ramHeadSize()
+{
+    if (!ramUsed_)
+        return 0;
+
+    uint8_t size = logRecordSize(ramAt(0));
+    if (!size || size > ramUsed_)
+    {
+        ramUsed_ = 0;
+        spilled_ = 0;
+        dropped_++;
+        return 0;
+    }
+    return size;
+}
+
+uint8_t LogQueue::eepromHeadSize()
+{
+    if (!eepromUsed_)
+        return 0;
+
+    uint8_t size = logRecordSize(eepromAt(0));
+    if (!size || size > eepromUsed_)
+    {
+        eepromUsed_ = 0;
+        spilled_ = 0;
+        dropped_++;
+        return 0;
+    }
+    return size;
+}
+
+void LogQueue::popRam(uint8_t size)
+{
+    ramHead_ = (ramHead_ + size) % LOG_QUEUE_RAM;
+    ramUsed_ -= size;
+    spilled_ = 0;
+}
+
+void LogQueue::popEeprom(uint8_t size)
+{
+    eepromHead_ = (eepromHead_ + size) % EEPROM_SPILL_SIZE;
+    eepromUsed_ -= size;
+}
+
+void LogQueue::push(const uint8_t* record, uint8_t size)
+{
+    // spill() keeps room in RAM unless it fell behind
+    while (LOG_QUEUE_RAM - ramUsed_ < size)
+    {
+        uint8_t old = ramHeadSize();
+        if (old)
+        {
+            popRam(old);
+            dropped_++;
+        }
+    }
+
+    for (uint8_t i = 0; i < size; i++)
+        ram_[(ramHead_ + ramUsed_ + i) % LOG_QUEUE_RAM] = record[i];
+    ramUsed_ += size;
+}
+
+bool LogQueue::spill()
+{
+#if LOG_QUEUE_EEPROM
+    if (!spillPending())
+        return false;
+    if (!eeprom_is_ready())
+        return true;
+
+    uint8_t size = ramHeadSize();
+    if (!size)
+        return false;
+
+    // Make room by dropping the oldest spilled records
+    if (!spilled_)
+    {
+        uint8_t old;
+        while (EEPROM_SPILL_SIZE - eepromUsed_ < size && (old = eepromHeadSize()))
+        {
+            popEeprom(old);
+            dropped_++;
+        }
+    }
+
+    EEPROM.update(EEPROM_SPILL_BASE + (eepromHead_ + eepromUsed_ + spilled_) % EEPROM_SPILL_SIZE,
+                  ramAt(spilled_));
+    if (++spilled_ == size)
+    {
+        eepromUsed_ += size;
+        popRam(size);
+    }
+    return spillPending();
+#else
+    return false;
+#endif
+}
+
+uint8_t LogQueue::peek(uint8_t* buf)
+{
+    uint8_t size;
+    if ((size = eepromHeadSize()))
+    {
+        for (uint8_t i = 0; i < size; i++)
+            buf[i] = eepromAt(i);
+        return size;
+    }
+
+    if ((size = ramHeadSize()))
+    {
+        for (uint8_t i = 0; i < size; i++)
+            buf[i] = ramAt(i);
+        return size;
+    }
+
+    return 0;
+}
+
+void LogQueue::pop()
+{
+    uint8_t size;
+    if ((size = eepromHeadSize()))
+        popEeprom(size);
+    else if ((size = ramHeadSize()))
+        popRam(size);
+}
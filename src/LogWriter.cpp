@@ -0,0 +1,322 @@
+#include "LogWriter.h"
+
+#include <EEPROM.h>
+#include <TimeLib.h>
+
+#include "DiagLog.h"
+#include "PerfCounters.h"
+
+// Longest text log line recover() accepts
+#define LOG_TEXT_LINE_MAX 96
+
+static void dayPath(char* path, uint8_t size, uint32_t time)
+{
+    snprintf_P(path, size, PSTR("/LOGS/%d/%d/%d"), year(time), month(time), day(time));
+}
+
+// The record's line in the stream's text log, opened on first use
+template <typename Stream>
+static bool writeText(const char* path, File& text, const uint8_t* record)
+{
+    uint32_t time;
+    int32_t values[Stream::fieldCount];
+    Stream::decode(record, &time, values);
+
+    if (!text)
+    {
+        PERF_SCOPE(SD_OPEN);
+        char name[32];
+        snprintf_P(name, sizeof(name), PSTR("%s/%S"), path, Stream::fileName());
+        text = SD.open(name, FILE_WRITE);
+        if (!text)
+            return false;
+    }
+
+    PERF_SCOPE(SD_WRITE);
+    char stamp[9];
+    snprintf_P(stamp, sizeof(stamp), PSTR("%02d:%02d:%02d"), hour(time), minute(time), second(time));
+    text.print(stamp);
+    Stream::printText(text, values);
+    return text.println() > 0;
+}
+
+// Fold a record that is on the card into its day's extremes
+template <typename Stream>
+static void indexRecord(const uint8_t* record, DayIndex* index)
+{
+    uint32_t time;
+    int32_t values[Stream::fieldCount];
+    Stream::decode(record, &time, values);
+    index->add<Stream>(time, values);
+}
+
+// Extend a binary day file over the intact records of that day found past
+// its recorded size; returns the bytes recovered
+static uint32_t recoverBinary(const char* name, uint16_t day)
+{
+    File f = SD.open(name, O_READ | O_WRITE);
+    if (!f)
+        return 0;
+
+    uint32_t start = f.size();
+    uint32_t end = start;
+    // The size on the card only changes once the end is known
+    if (f.extendForScan() > start && f.seek(start))
+    {
+        uint8_t record[LOG_RECORD_MAX];
+        while (f.read(record, 1) == 1)
+        {
+            uint8_t size = logRecordSize(record[0]);
+            if (!size || f.read(record + 1, size - 1) != size - 1 ||
+                !logRecordValid(record) || FieldCodec<4>::get(record + 1) / SECS_PER_DAY != day)
+                break;
+            end += size;
+        }
+        if (end != start)
+            f.setRecoveredSize(end);
+    }
+    f.close();
+    return end - start;
+}
+
+// Same for a text log: complete lines that parse as the stream's records
+template <typename Stream>
+static uint32_t recoverText(const char* name)
+{
+    File f = SD.open(name, O_READ | O_WRITE);
+    if (!f)
+        return 0;
+
+    uint32_t start = f.size();
+    uint32_t end = start;
+    if (f.extendForScan() > start && f.seek(start))
+    {
+        char line[LOG_TEXT_LINE_MAX];
+        uint8_t len = 0;
+        int c;
+        while ((c = f.read()) >= 0)
+        {
+            if (c == '\n')
+            {
+                uint32_t secondsOfDay;
+                int32_t values[Stream::fieldCount];
+                line[len] = 0;
+                if (!len || line[len - 1] != '\r' || !Stream::parseText(line, &secondsOfDay, values))
+                    break;
+                end += len + 1;
+                len = 0;
+            }
+            else if ((c < ' ' && c != '\r') || c > '~' || len == sizeof(line) - 1)
+                break;
+            else
+                line[len++] = c;
+        }
+        if (end != start)
+            f.setRecoveredSize(end);
+    }
+    f.close();
+    return end - start;
+}
+
+void LogWriter::begin(uint8_t csPin, bool cardOk, DayIndex* index)
+{
+    csPin_ = csPin;
+    cardOk_ = cardOk;
+    index_ = index;
+    files_.day = 0;
+    unsynced_ = 0;
+    textId_ = 0;
+    reinits_ = 0;
+    recovered_ = 0;
+    backoff_ = LOG_RETRY_MIN_MS;
+    retryAt_ = millis() + backoff_;
+
+    if (cardOk_)
+        recover();
+}
+
+void LogWriter::service()
+{
+    if (!cardOk_)
+    {
+        if ((int32_t)(millis() - retryAt_) < 0)
+            return;
+
+        if (!SD.begin(csPin_))
+        {
+            backoff_ = min(backoff_ * 2, (uint32_t)LOG_RETRY_MAX_MS);
+            retryAt_ = millis() + backoff_;
+            return;
+        }
+
+        cardOk_ = true;
+        backoff_ = LOG_RETRY_MIN_MS;
+        reinits_++;
+        DIAG_INFO("SD card back, %u bytes queued", queue_.bytes());
+        recover();
+    }
+
+    if (!queue_.empty() && !flush())
+    {
+        cardFailed();
+        return;
+    }
+
+    if (unsynced_ && (unsynced_ >= LOG_SYNC_RECORDS || millis() - unsyncedSince_ >= LOG_SYNC_MS))
+        sync();
+}
+
+bool LogWriter::flush()
+{
+    uint8_t record[LOG_RECORD_MAX];
+    uint8_t size;
+    for (uint8_t n = 0; n < LOG_FLUSH_BATCH && (size = queue_.peek(record)); n++)
+    {
+        uint32_t time = FieldCodec<4>::get(record + 1);
+        if (files_.day != time / SECS_PER_DAY)
+        {
+            closeDay();
+            if (!openDay(time))
+                return false;
+        }
+
+        // Text line, binary record, then the index. A failure leaves the
+        // record queued; a retry skips a text line already written, and
+        // the index only counts the record once both are on the card
+        if (textId_ != record[0] || textTime_ != time)
+        {
+            bool ok = true;
+            switch (record[0])
+            {
+#define LOG_WRITER_TEXT(Type, File, Id, Fields, LogMs) \
+            case Id: \
+                ok = writeText<Type>(files_.path, files_.text[LOG_STREAM_##Type], record); \
+                break;
+                LOG_STREAMS(LOG_WRITER_TEXT)
+#undef LOG_WRITER_TEXT
+            }
+            if (!ok)
+                return false;
+            textId_ = record[0];
+            textTime_ = time;
+        }
+
+        {
+            PERF_SCOPE(SD_WRITE);
+            if (files_.binary.write(record, size) != size)
+                return false;
+        }
+
+        switch (record[0])
+        {
+#define LOG_WRITER_INDEX(Type, File, Id, Fields, LogMs) \
+        case Id: \
+            indexRecord<Type>(record, index_); \
+            break;
+            LOG_STREAMS(LOG_WRITER_INDEX)
+#undef LOG_WRITER_INDEX
+        }
+
+        queue_.pop();
+        textId_ = 0;
+        if (!unsynced_++)
+            unsyncedSince_ = millis();
+    }
+
+    index_->setDataBytes(files_.binary.size());
+    return true;
+}
+
+void LogWriter::sync()
+{
+    PERF_SCOPE(SD_SYNC);
+    if (files_.binary)
+        files_.binary.flush();
+    for (uint8_t i = 0; i < LOG_STREAM_COUNT; i++)
+        if (files_.text[i])
+            files_.text[i].flush();
+    unsynced_ = 0;
+}
+
+bool LogWriter::openDay(uint32_t time)
+{
+    PERF_SCOPE(SD_OPEN);
+    dayPath(files_.path, sizeof(files_.path), time);
+    if (!SD.exists(files_.path))
+        SD.mkdir(files_.path);
+
+    char name[32];
+    snprintf_P(name, sizeof(name), PSTR("%s/" LOG_BINARY_FILE), files_.path);
+    files_.binary = SD.open(name, FILE_WRITE);
+    if (!files_.binary)
+        return false;
+
+    // Remember which day recover() has to look at after a reset
+    files_.day = time / SECS_PER_DAY;
+    EEPROM.put(EEPROM_LOG_DAY_BASE, files_.day);
+    return true;
+}
+
+void LogWriter::closeDay()
+{
+    PERF_SCOPE(SD_SYNC);
+    if (files_.binary)
+    {
+        index_->setDataBytes(files_.binary.size());
+        files_.binary.close();
+    }
+    for (uint8_t i = 0; i < LOG_STREAM_COUNT; i++)
+        if (files_.text[i])
+            files_.text[i].close();
+    files_.day = 0;
+    unsynced_ = 0;
+}
+
+void LogWriter::cardFailed()
+{
+    closeDay();
+    cardOk_ = false;
+    retryAt_ = millis() + backoff_;
+    DIAG_WARN("SD write failed, queueing (%u bytes)", queue_.bytes());
+}
+
+void LogWriter::recover()
+{
+    uint16_t day;
+    EEPROM.get(EEPROM_LOG_DAY_BASE, day);
+    if (day < DAY_INDEX_FIRST_DAY || day == 0xFFFF)
+        return;
+
+    char path[20];
+    char name[32];
+    dayPath(path, sizeof(path), (uint32_t)day * SECS_PER_DAY);
+
+    uint32_t bytes = 0;
+    snprintf_P(name, sizeof(name), PSTR("%s/" LOG_BINARY_FILE), path);
+    bytes += recoverBinary(name, day);
+
+#define LOG_WRITER_RECOVER(Type, File, Id, Fields, LogMs) \
+    snprintf_P(name, sizeof(name), PSTR("%s/%S"), path, Type::fileName()); \
+    bytes += recoverText<Type>(name);
+    LOG_STREAMS(LOG_WRITER_RECOVER)
+#undef LOG_WRITER_RECOVER
+
+    if (bytes)
+        DIAG_WARN("Recovered %lu bytes of unsynced logs in %s", bytes, path);
+    recovered_ += bytes;
+}
+
+void LogWriter::printJson(Print& out) const
+{
+    out.print(F("{\"card\":"));
+    out.print(cardOk_ ? F("true") : F("false"));
+    out.print(F(",\"queued\":"));
+    out.print(queue_.bytes());
+    out.print(F(",\"dropped\":"));
+    out.print(queue_.dropped());
+    out.print(F(",\"reinits\":"));
+    out.print(reinits_);
+    out.print(F(",\"recovered\":"));
+    out.print(recovered_);
+    out.print('}');
+}
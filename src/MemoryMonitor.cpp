@@ -0,0 +1,118 @@
+#include "MemoryMonitor.h"
+
+#include <stdlib.h>
+
+// avr-libc malloc internals
+struct __freelist
+{
+    size_t sz;
+    struct __freelist* nx;
+};
+
+extern char __heap_start;
+extern char* __brkval;
+extern struct __freelist* __flp;
+extern size_t __malloc_margin;
+
+// Runs between stack pointer setup (.init2) and .data/.bss initialisation
+// (.init4); naked, so nothing of ours is on the stack yet
+void paintMemory(void) __attribute__((naked, used, section(".init3")));
+
+void paintMemory(void)
+{
+    for (uint8_t* p = (uint8_t*)&__heap_start; p <= (uint8_t*)RAMEND; p++)
+        *p = MEMORY_PAINT;
+}
+
+static char* heapTop()
+{
+    return __brkval ? __brkval : &__heap_start;
+}
+
+void MemoryMonitor::update()
+{
+    char* top = heapTop();
+    char* sp = (char*)SP;
+
+    stats_.staticSize = &__heap_start - (char*)RAMSTART;
+    stats_.heapSize = top - &__heap_start;
+    if (stats_.heapSize > stats_.heapPeak)
+        stats_.heapPeak = stats_.heapSize;
+    stats_.stackSize = (char*)RAMEND - sp;
+
+    uint16_t listFree = 0;
+    uint16_t listLargest = 0;
+    for (struct __freelist* fp = __flp; fp; fp = fp->nx)
+    {
+        // each chunk also carries its size word
+        listFree += fp->sz + sizeof(size_t);
+        if (fp->sz > listLargest)
+            listLargest = fp->sz;
+    }
+    stats_.heapFree = listFree;
+
+    // malloc can also extend the break up to __malloc_margin below SP
+    int16_t gap = sp - __malloc_margin - top - (int16_t)sizeof(size_t);
+    if (gap < 0)
+        gap = 0;
+    stats_.largestFree = (uint16_t)gap > listLargest ? gap : listLargest;
+
+    uint16_t total = listFree + gap;
+    stats_.fragmentation = total ? 100 - (uint32_t)stats_.largestFree * 100 / total : 0;
+
+    // First byte above the heap the stack has written; ISRs push below SP
+    // at any time, so stop there
+    const uint8_t* p = (const uint8_t*)top;
+    while (p < (const uint8_t*)sp && *p == MEMORY_PAINT)
+        p++;
+    stats_.untouched = p - (const uint8_t*)top;
+
+    uint16_t peak = (const uint8_t*)RAMEND - p + 1;
+    if (peak > stats_.stackPeak)
+        stats_.stackPeak = peak;
+}
+
+void MemoryMonitor::printStats(Print& out) const
+{
+    out.print(F("ram: static "));
+    out.print(stats_.staticSize);
+    out.print(F(", heap "));
+    out.print(stats_.heapSize);
+    out.print(F(" (peak "));
+    out.print(stats_.heapPeak);
+    out.print(F(", free list "));
+    out.print(stats_.heapFree);
+    out.print(F(", largest "));
+    out.print(stats_.largestFree);
+    out.print(F(", frag "));
+    out.print(stats_.fragmentation);
+    out.print(F("%), stack "));
+    out.print(stats_.stackSize);
+    out.print(F(" (peak "));
+    out.print(stats_.stackPeak);
+    out.print(F("), never used "));
+    out.println(stats_.untouched);
+}
+
+void MemoryMonitor::printJson(Print& out) const
+{
+    out.print(F("{\"static\":"));
+    out.print(stats_.staticSize);
+    out.print(F(",\"heap\":"));
+    out.print(stats_.heapSize);
+    out.print(F(",\"heap_peak\":"));
+    out.print(stats_.heapPeak);
+    out.print(F(",\"heap_free\":"));
+    out.print(stats_.heapFree);
+    out.print(F(",\"largest_free\":"));
+    out.print(stats_.largestFree);
+    out.print(F(",\"fragmentation\":"));
+    out.print(stats_.fragmentation);
+    out.print(F(",\"stack\":"));
+    out.print(stats_.stackSize);
+    out.print(F(",\"stack_peak\":"));
+    out.print(stats_.stackPeak);
+    out.print(F(",\"untouched\":"));
+    out.print(stats_.untouched);
+    out.print('}');
+}
@@ -0,0 +1,99 @@
+#include "PerfCounters.h"
+
+PerfCounters perf;
+
+#define PERF_NAME(id, name) static const char perfName_##id[] PROGMEM = name;
+PERF_SECTIONS(PERF_NAME)
+#undef PERF_NAME
+
+#define PERF_NAME_PTR(id, name) perfName_##id,
+static const char* const perfNames[PERF_SECTION_COUNT] PROGMEM = {
+    PERF_SECTIONS(PERF_NAME_PTR)
+};
+#undef PERF_NAME_PTR
+
+const char* PerfCounters::name(uint8_t section)
+{
+    return (const char*)pgm_read_ptr(&perfNames[section]);
+}
+
+void PerfCounters::record(uint8_t section, uint32_t us)
+{
+    PerfStats& s = stats_[section];
+    s.count++;
+
+    uint32_t total = s.totalUs + us;
+    s.totalMs += total / 1000;
+    s.totalUs = total % 1000;
+
+    if (us > s.maxUs)
+        s.maxUs = us;
+
+    uint8_t bin = 0;
+    while (us > 1 && bin < PERF_BINS - 1)
+    {
+        us >>= 1;
+        bin++;
+    }
+    if (s.hist[bin] != 0xFFFF)
+        s.hist[bin]++;
+}
+
+void PerfCounters::reset()
+{
+    memset(stats_, 0, sizeof(stats_));
+}
+
+void PerfCounters::printTable(Print& out) const
+{
+    out.println(F("section     count  total_ms  avg_us  max_us"));
+    for (uint8_t i = 0; i < PERF_SECTION_COUNT; i++)
+    {
+        const PerfStats& s = stats_[i];
+        if (!s.count)
+            continue;
+
+        out.print(reinterpret_cast<const __FlashStringHelper*>(name(i)));
+        out.print('\t');
+        out.print(s.count);
+        out.print('\t');
+        out.print(s.totalMs);
+        out.print('\t');
+        out.print((uint32_t)(((uint64_t)s.totalMs * 1000 + s.totalUs) / s.count));
+        out.print('\t');
+        out.println(s.maxUs);
+    }
+}
+
+void PerfCounters::printJson(Print& out) const
+{
+    out.print('{');
+    for (uint8_t i = 0; i < PERF_SECTION_COUNT; i++)
+    {
+        if (i)
+            out.print(',');
+        printJson(out, i);
+    }
+    out.print('}');
+}
+
+void PerfCounters::printJson(Print& out, uint8_t section) const
+{
+    const PerfStats& s = stats_[section];
+    out.print('"');
+    out.print(reinterpret_cast<const __FlashStringHelper*>(name(section)));
+    out.print(F("\":{\"count\":"));
+    out.print(s.count);
+    out.print(F(",\"total_ms\":"));
+    out.print(s.totalMs);
+    out.print(F(",\"max_us\":"));
+    out.print(s.maxUs);
+    out.print(F(",\"hist\":["));
+    for (uint8_t b = 0; b < PERF_BINS; b++)
+    {
+        if (b)
+            out.print(',');
+        out.print(s.hist[b]);
+    }
+    out.print(F("]}"));
+}
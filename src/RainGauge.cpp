@@ -0,0 +1,141 @@
+#include "RainGauge.h"
+
+#include <EEPROM.h>
+#include <stddef.h>
+#include <util/atomic.h>
+
+volatile uint16_t RainGauge::isrTips_ = 0;
+volatile uint32_t RainGauge::isrLastTipMs_ = 0;
+
+void RainGauge::onTip()
+{
+    // Runs with interrupts disabled, so millis() is consistent here
+    uint32_t now = millis();
+    if (now - isrLastTipMs_ >= RAIN_DEBOUNCE_MS)
+    {
+        isrLastTipMs_ = now;
+        isrTips_++;
+    }
+}
+
+void RainGauge::begin(uint8_t pin)
+{
+    load();
+    persistedTips_ = totalTips_;
+
+    for (uint8_t i = 0; i < RAIN_RATE_BUCKETS; i++)
+        buckets_[i] = 0;
+
+    bucketIndex_ = 0;
+    bucketStartMs_ = millis();
+
+    seenTips_ = 0;
+    pinMode(pin, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(pin), onTip, FALLING);
+}
+
+void RainGauge::sample()
+{
+    uint16_t tips;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tips = isrTips_;
+    }
+
+    // The ISR counter free-runs; unsigned subtraction handles the wrap
+    uint16_t delta = tips - seenTips_;
+    seenTips_ = tips;
+    totalTips_ += delta;
+
+    // Advance the rate window, clearing buckets we skipped over
+    uint32_t now = millis();
+    uint8_t steps = 0;
+    while (now - bucketStartMs_ >= RAIN_RATE_BUCKET_MS && steps < RAIN_RATE_BUCKETS)
+    {
+        bucketIndex_ = (bucketIndex_ + 1) % RAIN_RATE_BUCKETS;
+        buckets_[bucketIndex_] = 0;
+        bucketStartMs_ += RAIN_RATE_BUCKET_MS;
+        steps++;
+    }
+    if (now - bucketStartMs_ >= RAIN_RATE_BUCKET_MS)
+        bucketStartMs_ = now;       // idle for longer than the whole window
+
+    buckets_[bucketIndex_] += delta;
+}
+
+void RainGauge::rollup()
+{
+    if (totalTips_ != persistedTips_)
+        persist();
+}
+
+float RainGauge::totalMm() const
+{
+    return totalTips_ * (RAIN_UM_PER_TIP / 1000.0);
+}
+
+float RainGauge::rateMmPerHour() const
+{
+    uint32_t tips = 0;
+    for (uint8_t i = 0; i < RAIN_RATE_BUCKETS; i++)
+        tips += buckets_[i];
+
+    // window length in hours
+    const float windowH = (RAIN_RATE_BUCKETS * RAIN_RATE_BUCKET_MS) / 3600000.0;
+    return tips * (RAIN_UM_PER_TIP / 1000.0) / windowH;
+}
+
+uint8_t RainGauge::checksum(const Slot& slot)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&slot);
+    uint8_t sum = 0xA5;
+    for (uint8_t i = 0; i < offsetof(Slot, check); i++)
+        sum = (sum << 1 | sum >> 7) ^ p[i];
+    return sum;
+}
+
+void RainGauge::persist()
+{
+    slot_ = (slot_ + 1) % RAIN_EEPROM_SLOTS;
+    seq_++;
+
+    Slot s;
+    s.seq = seq_;
+    s.tips = totalTips_;
+    s.reserved = 0;
+    s.check = checksum(s);
+    EEPROM.put(EEPROM_RAIN_BASE + slot_ * sizeof(Slot), s);
+
+    persistedTips_ = totalTips_;
+}
+
+void RainGauge::load()
+{
+    // The newest slot is the valid one whose successor in the ring does
+    // not carry the next sequence number
+    totalTips_ = 0;
+    seq_ = 0;
+    slot_ = RAIN_EEPROM_SLOTS - 1;   // so the first persist() lands on slot 0
+
+    bool found = false;
+    for (uint8_t i = 0; i < RAIN_EEPROM_SLOTS; i++)
+    {
+        Slot s, next;
+        EEPROM.get(EEPROM_RAIN_BASE + i * sizeof(Slot), s);
+        if (s.check != checksum(s))
+            continue;
+
+        uint8_t n = (i + 1) % RAIN_EEPROM_SLOTS;
+        EEPROM.get(EEPROM_RAIN_BASE + n * sizeof(Slot), next);
+        if (next.check == checksum(next) && next.seq == (uint16_t)(s.seq + 1))
+            continue;
+
+        if (!found || s.tips > totalTips_)
+        {
+            totalTips_ = s.tips;
+            seq_ = s.seq;
+            slot_ = i;
+            found = true;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include "Scheduler.h"
+
+int8_t Scheduler::add(PGM_P name, TaskCallback callback, uint32_t intervalMs, uint32_t firstDelayMs)
+{
+    if (count_ >= SCHEDULER_MAX_TASKS)
+        return -1;
+
+    uint8_t id = count_++;
+    Task& t = tasks_[id];
+    t.name = name;
+    t.callback = callback;
+    t.interval = intervalMs;
+    t.deadline = millis() + firstDelayMs;
+    memset(&t.stats, 0, sizeof(t.stats));
+
+    insert(id);
+    return id;
+}
+
+void Scheduler::wake(int8_t id)
+{
+    Task& t = tasks_[id];
+    uint32_t now = millis();
+    if (t.heapPos == SCHEDULER_STOPPED)
+    {
+        t.deadline = now;
+        insert(id);
+    }
+    else if ((int32_t)(t.deadline - now) > 0)
+    {
+        t.deadline = now;
+        siftUp(t.heapPos);
+    }
+}
+
+void Scheduler::stop(int8_t id)
+{
+    Task& t = tasks_[id];
+    uint8_t pos = t.heapPos;
+    if (pos == SCHEDULER_STOPPED)
+        return;
+
+    t.heapPos = SCHEDULER_STOPPED;
+    if (pos == --active_)
+        return;
+
+    // Move the last heap entry into the hole and restore the order
+    heap_[pos] = heap_[active_];
+    tasks_[heap_[pos]].heapPos = pos;
+    siftUp(pos);
+    siftDown(tasks_[heap_[pos]].heapPos);
+}
+
+void Scheduler::setInterval(int8_t id, uint32_t intervalMs)
+{
+    Task& t = tasks_[id];
+    t.deadline += intervalMs - t.interval;
+    t.interval = intervalMs;
+    if (t.heapPos == SCHEDULER_STOPPED)
+        return;
+    siftUp(t.heapPos);
+    siftDown(tasks_[id].heapPos);
+}
+
+uint8_t Scheduler::run()
+{
+    uint8_t ran = 0;
+
+    // Bounded so a zero-interval task cannot starve the caller
+    while (active_ && ran < active_)
+    {
+        uint32_t now = millis();
+        uint8_t id = heap_[0];
+        Task& t = tasks_[id];
+
+        int32_t late = (int32_t)(now - t.deadline);
+        if (late < 0)
+            break;
+
+        t.stats.runs++;
+        t.stats.lateSum += late;
+        if ((uint32_t)late > t.stats.lateMax)
+            t.stats.lateMax = late > 0xFFFF ? 0xFFFF : late;
+
+        if ((uint32_t)late >= t.interval && t.interval)
+        {
+            t.stats.overruns++;
+            t.deadline = now + t.interval;
+        }
+        else
+            t.deadline += t.interval;
+
+        siftDown(0);
+
+        // The callback may stop or wake tasks, including itself
+        t.callback();
+        ran++;
+    }
+    return ran;
+}
+
+uint32_t Scheduler::timeUntilNext() const
+{
+    if (!active_)
+        return 0xFFFFFFFF;
+
+    int32_t left = (int32_t)(tasks_[heap_[0]].deadline - millis());
+    return left > 0 ? left : 0;
+}
+
+void Scheduler::printStats(Print& out) const
+{
+    out.println(F("task      runs  late_avg  late_max  overruns"));
+    for (uint8_t i = 0; i < count_; i++)
+    {
+        const Task& t = tasks_[i];
+        out.print(reinterpret_cast<const __FlashStringHelper*>(t.name));
+        out.print('\t');
+        out.print(t.stats.runs);
+        out.print('\t');
+        out.print(t.stats.runs ? t.stats.lateSum / t.stats.runs : 0);
+        out.print('\t');
+        out.print(t.stats.lateMax);
+        out.print('\t');
+        out.println(t.stats.overruns);
+    }
+}
+
+void Scheduler::insert(uint8_t id)
+{
+    uint8_t pos = active_++;
+    heap_[pos] = id;
+    tasks_[id].heapPos = pos;
+    siftUp(pos);
+}
+
+void Scheduler::swap(uint8_t i, uint8_t j)
+{
+    uint8_t a = heap_[i];
+    uint8_t b = heap_[j];
+    heap_[i] = b;
+    heap_[j] = a;
+    tasks_[b].heapPos = i;
+    tasks_[a].heapPos = j;
+}
+
+void Scheduler::siftUp(uint8_t pos)
+{
+    while (pos > 0)
+    {
+        uint8_t parent = (pos - 1) / 2;
+        if (!earlier(heap_[pos], heap_[parent]))
+            break;
+        swap(pos, parent);
+        pos = parent;
+    }
+}
+
+void Scheduler::siftDown(uint8_t pos)
+{
+    while (true)
+    {
+        uint8_t left = 2 * pos + 1;
+        if (left >= active_)
+            break;
+
+        uint8_t child = left;
+        if (left + 1 < active_ && earlier(heap_[left + 1], heap_[left]))
+            child = left + 1;
+
+        if (!earlier(heap_[child], heap_[pos]))
+            break;
+        swap(pos, child);
+        pos = child;
+    }
+}
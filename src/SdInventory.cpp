@@ -0,0 +1,58 @@
+#include "SdInventory.h"
+
+void SdInventory::begin(const char* path)
+{
+    close();
+    files_ = 0;
+    dirs_ = 0;
+    bytes_ = 0;
+
+    stack_[0] = SD.open(path);
+    if (stack_[0])
+        depth_ = 1;
+}
+
+bool SdInventory::step(Print& out, uint8_t maxEntries)
+{
+    while (depth_ && maxEntries)
+    {
+        File entry = stack_[depth_ - 1].openNextFile();
+        if (!entry)
+        {
+            // this directory is finished, go back to its parent
+            stack_[--depth_].close();
+            continue;
+        }
+        maxEntries--;
+
+        for (uint8_t i = 1; i < depth_; i++)
+            out.print('\t');
+        out.print(entry.name());
+
+        if (entry.isDirectory())
+        {
+            dirs_++;
+            out.println('/');
+            if (depth_ < SD_INVENTORY_DEPTH)
+            {
+                stack_[depth_++] = entry;
+                continue;
+            }
+        }
+        else
+        {
+            files_++;
+            bytes_ += entry.size();
+            out.print(F("\t\t"));
+            out.println(entry.size(), DEC);
+        }
+        entry.close();
+    }
+    return depth_ != 0;
+}
+
+void SdInventory::close()
+{
+    while (depth_)
+        stack_[--depth_].close();
+}
@@ -0,0 +1,70 @@
+#include "SpiBus.h"
+
+SpiBus spiBus;
+
+#define SPI_DEVICE_NAME(id, name) static const char spiDeviceName_##id[] PROGMEM = name;
+SPI_DEVICES(SPI_DEVICE_NAME)
+#undef SPI_DEVICE_NAME
+
+#define SPI_DEVICE_NAME_PTR(id, name) spiDeviceName_##id,
+static const char* const spiDeviceNames[SPI_DEVICE_COUNT] PROGMEM = {
+    SPI_DEVICES(SPI_DEVICE_NAME_PTR)
+};
+#undef SPI_DEVICE_NAME_PTR
+
+// The SD library's bus hooks, replacing its plain SPI transactions
+void sdSpiBegin(const SPISettings& settings)
+{
+    spiBus.acquire(SPI_DEVICE_SD, settings);
+}
+
+void sdSpiEnd(void)
+{
+    spiBus.release(SPI_DEVICE_SD);
+}
+
+const char* SpiBus::name(uint8_t device)
+{
+    return (const char*)pgm_read_ptr(&spiDeviceNames[device]);
+}
+
+void SpiBus::acquire(uint8_t device, const SPISettings& settings)
+{
+    SpiDeviceStats& s = stats_[device];
+    s.transactions++;
+
+#ifdef SPCR
+    // SPSR holds flags besides SPI2X, only the clock bit is settings
+    uint8_t spcr = SPCR;
+    uint8_t spi2x = SPSR & _BV(SPI2X);
+    SPI.beginTransaction(settings);
+    if (SPCR != spcr || (SPSR & _BV(SPI2X)) != spi2x)
+        s.reconfigs++;
+#else
+    SPI.beginTransaction(settings);
+#endif
+}
+
+void SpiBus::release(uint8_t device)
+{
+    (void)device;
+    SPI.endTransaction();
+}
+
+void SpiBus::printJson(Print& out) const
+{
+    out.print('{');
+    for (uint8_t i = 0; i < SPI_DEVICE_COUNT; i++)
+    {
+        if (i)
+            out.print(',');
+        out.print('"');
+        out.print(reinterpret_cast<const __FlashStringHelper*>(name(i)));
+        out.print(F("\":{\"transactions\":"));
+        out.print(stats_[i].transactions);
+        out.print(F(",\"reconfigs\":"));
+        out.print(stats_[i].reconfigs);
+        out.print('}');
+    }
+    out.print('}');
+}
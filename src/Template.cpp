@@ -0,0 +1,111 @@
+#include "Template.h"
+
+#include <ctype.h>
+
+void TemplateRenderer::begin(TemplateResolver resolve)
+{
+    resolve_ = resolve;
+    state_ = TEXT;
+    nameLen_ = 0;
+}
+
+void TemplateRenderer::write(const uint8_t* data, size_t size, Print& out)
+{
+    const uint8_t* end = data + size;
+    while (data < end)
+    {
+        if (state_ == TEXT)
+        {
+            // Plain text up to the next '{' goes out in one write
+            const uint8_t* brace = (const uint8_t*)memchr(data, '{', end - data);
+            if (!brace)
+            {
+                out.write(data, end - data);
+                return;
+            }
+            if (brace > data)
+                out.write(data, brace - data);
+            data = brace + 1;
+            state_ = OPEN;
+            continue;
+        }
+
+        char c = *data;
+        switch (state_)
+        {
+        case OPEN:
+            if (c != '{')
+            {
+                // A lone brace; c may start the next placeholder
+                out.write('{');
+                state_ = TEXT;
+                continue;
+            }
+            state_ = NAME;
+            nameLen_ = 0;
+            break;
+
+        case NAME:
+            if (c == '}' && nameLen_)
+            {
+                state_ = CLOSE;
+                break;
+            }
+            if (c == '{' && !nameLen_)
+            {
+                // "{{{name}}": the first brace is text
+                out.write('{');
+                break;
+            }
+            if ((isalnum(c) || c == '_') && nameLen_ < TEMPLATE_NAME_MAX - 1)
+            {
+                name_[nameLen_++] = c;
+                break;
+            }
+            literal(out);
+            state_ = TEXT;
+            continue;
+
+        case CLOSE:
+            if (c != '}')
+            {
+                literal(out);
+                state_ = TEXT;
+                continue;
+            }
+            name_[nameLen_] = 0;
+            if (!resolve_ || !resolve_(name_, out))
+            {
+                literal(out);
+                out.write('}');
+            }
+            state_ = TEXT;
+            break;
+
+        default:
+            break;
+        }
+        data++;
+    }
+}
+
+void TemplateRenderer::end(Print& out)
+{
+    literal(out);
+    state_ = TEXT;
+}
+
+// What was held back of a placeholder, unchanged
+void TemplateRenderer::literal(Print& out)
+{
+    if (state_ == TEXT)
+        return;
+
+    out.write('{');
+    if (state_ == OPEN)
+        return;
+    out.write('{');
+    out.write((const uint8_t*)name_, nameLen_);
+    if (state_ == CLOSE)
+        out.write('}');
+}
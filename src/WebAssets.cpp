@@ -0,0 +1,17 @@
+#include "WebAssets.h"
+
+// Generated before every build from sd-card/, see tools/webassets.py
+#include "WebAssetData.h"
+
+bool findWebAsset(const char* path, WebAsset* asset)
+{
+    for (uint8_t i = 0; i < WEB_ASSET_COUNT; i++)
+    {
+        if (strcasecmp_P(path, (PGM_P)pgm_read_ptr(&webAssets[i].path)) == 0)
+        {
+            memcpy_P(asset, &webAssets[i], sizeof(*asset));
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+#include "WindVane.h"
+
+#include <avr/pgmspace.h>
+#include <math.h>
+#include <util/atomic.h>
+
+// ADC readings for the 16 vane positions with a 10k pull-up to AVcc
+// (SparkFun/Argent weather meter), sorted ascending. Each entry holds the
+// upper bound of its band (midway to the next reading) and the sector.
+struct VaneBand
+{
+    uint16_t upper;
+    uint8_t sector;
+};
+
+static const VaneBand vaneBands[16] PROGMEM = {
+    {   75,  5 },   //  66  ESE
+    {   88,  3 },   //  84  ENE
+    {  109,  4 },   //  92  E
+    {  155,  7 },   // 127  SSE
+    {  213,  6 },   // 184  SE
+    {  265,  9 },   // 243  SSW
+    {  346,  8 },   // 287  S
+    {  432,  1 },   // 405  NNE
+    {  530,  2 },   // 460  NE
+    {  615, 11 },   // 600  WSW
+    {  666, 10 },   // 630  SW
+    {  744, 15 },   // 702  NNW
+    {  806,  0 },   // 786  N
+    {  856, 13 },   // 827  WNW
+    {  915, 14 },   // 886  NW
+    { 1023, 12 },   // 945  W
+};
+
+// Unit vectors per sector: x = east, y = north
+static const int8_t sectorX[16] PROGMEM = {
+    0, 49, 90, 117, 127, 117, 90, 49, 0, -49, -90, -117, -127, -117, -90, -49
+};
+static const int8_t sectorY[16] PROGMEM = {
+    127, 117, 90, 49, 0, -49, -90, -117, -127, -117, -90, -49, 0, 49, 90, 117
+};
+
+static const char sectorNames[16][4] PROGMEM = {
+    "N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE",
+    "S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW"
+};
+
+volatile int32_t WindVane::sumX_ = 0;
+volatile int32_t WindVane::sumY_ = 0;
+volatile uint16_t WindVane::count_ = 0;
+volatile uint8_t WindVane::skip_ = WIND_VANE_DECIMATION;
+volatile uint8_t WindVane::conversions_ = 0;
+
+ISR(ADC_vect)
+{
+    WindVane::onConversion(ADC);
+}
+
+void WindVane::onConversion(uint16_t value)
+{
+    conversions_++;
+    if (--skip_)
+        return;
+    skip_ = WIND_VANE_DECIMATION;
+
+    uint8_t i = 0;
+    while (value > pgm_read_word(&vaneBands[i].upper))
+        i++;
+
+    uint8_t sector = pgm_read_byte(&vaneBands[i].sector);
+    sumX_ += (int8_t)pgm_read_byte(&sectorX[sector]);
+    sumY_ += (int8_t)pgm_read_byte(&sectorY[sector]);
+    count_++;
+}
+
+void WindVane::begin(uint8_t channel)
+{
+    // AVcc reference, right adjusted, channel 0..15
+    ADMUX = _BV(REFS0) | (channel & 0x07);
+
+    // Timer0 overflow trigger source; MUX5 selects ADC8..15
+    ADCSRB = _BV(ADTS2) | ((channel & 0x08) ? _BV(MUX5) : 0);
+
+    // Enable, auto-trigger, interrupt, prescaler 128 (a conversion takes
+    // ~104 us, well inside the 1.024 ms between triggers)
+    ADCSRA = _BV(ADEN) | _BV(ADATE) | _BV(ADIE) |
+             _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+}
+
+bool WindVane::read(WindVaneSample* sample)
+{
+    int32_t x, y;
+    uint16_t n;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        x = sumX_;
+        y = sumY_;
+        n = count_;
+        sumX_ = 0;
+        sumY_ = 0;
+        count_ = 0;
+    }
+
+    if (n == 0)
+        return false;
+
+    float deg = atan2((float)x, (float)y) * (180.0 / M_PI);
+    if (deg < 0)
+        deg += 360.0;
+
+    sample->direction = deg;
+    sample->sector = (uint8_t)((deg + 11.25) / 22.5) & 0x0F;
+    sample->steadiness = sqrt((float)x * x + (float)y * y) / ((float)n * WIND_VANE_UNIT);
+    sample->count = n;
+    return true;
+}
+
+const char* WindVane::sectorName(uint8_t sector)
+{
+    static char name[4];
+    strcpy_P(name, sectorNames[sector & 0x0F]);
+    return name;
+}
@@ -1,5 +1,4 @@
 #include <SPI.h>
-#include <Thread.h>
 #include <SD.h>
 #include <Ethernet.h>
 #include <EthernetUdp.h>
@@ -8,31 +7,114 @@
 #include <OneWire.h>
 #include <DallasTemperature.h>
 
-// ############## Defines ##############
+#include "Bmp280.h"
+#include "Channels.h"
+#include "DayIndex.h"
+#include "DiagLog.h"
+#include "HttpServer.h"
+#include "IdleSleep.h"
+#include "LogWriter.h"
+#include "MemoryMonitor.h"
+#include "PerfCounters.h"
+#include "RainGauge.h"
+#include "Scheduler.h"
+#include "SdInventory.h"
+#include "SpiBus.h"
+#include "Template.h"
+#include "WebAssets.h"
+#include "WindVane.h"
 
-// How big our line buffer should be
-#define BUFSIZ 96
+// ############## Defines ##############
 
 #define TEMP_WIRE 7
 
-// store error strings in flash to save RAM
-#define error(s) error_P(PSTR(s))
+// Tipping-bucket reed switch, must be an external interrupt pin
+#define RAIN_PIN 19
+
+// Wind vane resistor ladder on ADC channel 0 (A0)
+#define WIND_VANE_CHANNEL 0
+
+// BMP280/BME280 on the I2C bus (SDO to GND = 0x76, to VCC = 0x77)
+#define BARO_ADDR 0x76
+#define BARO_OSRS_T BMP280_OSRS_X2
+#define BARO_OSRS_P BMP280_OSRS_X16
+#define BARO_OSRS_H BMP280_OSRS_X1
+#define BARO_FILTER BMP280_FILTER_4
+
  
 #define SDCARD_CS 4 
 #define WIZ_CS 10
 
+// W5100/W5500 INT line (needs the INT jumper on most shields)
+#define ETH_INT_PIN 2
+
+// Task intervals (ms); the sensor task is the tick the channel sample
+// intervals are measured against
+#define SENSOR_INTERVAL 1000
+#define NTP_INTERVAL 60000
+#define ROLLUP_INTERVAL RAIN_PERSIST_MS
+// Fallback poll in case an INT edge is missed; events wake it right away
+#define NET_POLL_INTERVAL 50
+#define STATS_INTERVAL 600000
+
+// Background listing of the card to the serial log after boot; set to 0
+// to skip it. A couple of entries per slice stays below what the UART
+// drains in the same time, so the listing never blocks on the log.
+#define SD_INVENTORY 1
+#define INVENTORY_INTERVAL 25
+#define INVENTORY_ENTRIES 2
+
+// Counts free clusters a few FAT blocks per slice after mounting; a FAT32
+// FSINFO count is only reported until then, since it is a hint that goes
+// stale whenever power is cut with a file open. /api/storage wakes it
+#define FREE_SCAN_INTERVAL 25
+#define FREE_SCAN_BLOCKS 4
+
+// Moves a card backlog from RAM to EEPROM a byte per slice, just slower
+// than an EEPROM write (~3.4 ms) so a slice never waits on one; the
+// sensor task wakes it once the backlog is deep enough
+#define LOG_SPILL_INTERVAL 4
+
+// Directory listing entries per part of the page
+#define LIST_ENTRIES 4
+
+// Scratch file size for POST /debug/sdbench, in card blocks; the route
+// only exists in builds with -DSD_BENCH (see platformio.ini)
+#define SD_BENCH_BLOCKS 64
+
+// Boot phases recorded for /debug/stats
+#define BOOT_PHASES 4
+
 //  ^^^^^^^^^^^^^ Defines ^^^^^^^^^^^^^
 
 // ############## Vars ##############
 
-Thread sensorReader = Thread();
+Scheduler scheduler;
+int8_t netPollTask;
+
+IdleSleep idle;
+
+MemoryMonitor memory;
 
 byte mac[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };
 byte ip[] = { 10, 0, 1, 202 };
 
 EthernetServer server(80);
+void handleRequest(HttpConnection& conn);
+HttpServer web(server, handleRequest);
 
-File root;
+DayIndex dayIndex;
+LogWriter logWriter;
+
+SdInventory inventory;
+int8_t inventoryTask;
+int8_t freeScanTask;
+int8_t logSpillTask;
+
+// ms since reset at the end of each boot phase
+PGM_P bootPhaseName[BOOT_PHASES];
+uint16_t bootPhaseMs[BOOT_PHASES];
+uint8_t bootPhases;
 
 EthernetUDP ntpUDP;
 NTPClient timeClient(ntpUDP);
@@ -40,29 +122,40 @@ NTPClient timeClient(ntpUDP);
 OneWire oneWire(TEMP_WIRE);
 DallasTemperature sensors(&oneWire);
 
+RainGauge rainGauge;
+
+WireBmp280Bus baroBus;
+Bmp280 barometer;
+
+WindVane windVane;
+
 //  ^^^^^^^^^^^^^ Vars ^^^^^^^^^^^^^
 
 
-void error_P(const char* str) 
+// Directory page for HttpConnection::generate(), LIST_ENTRIES entries of
+// conn.file() per part
+bool ListFiles(HttpConnection& conn, Print& client) 
 {
-  Serial.print(F("error: "));
-  Serial.println(str);
- 
-  while(1);
-}
- 
-void ListFiles(EthernetClient client, uint8_t flags, File dir) 
-{
-    client.println("<ul>");
-    while (true) 
+    if (!conn.cursor()++)
     {
-        File entry = dir.openNextFile();
+        // handleRequest() left the path in the request line
+        client.print("<h2>Files in /");
+        client.print(conn.request() + 5);
+        client.println(":</h2>");
+        client.println("<ul>");
+        return true;
+    }
+
+    for (uint8_t i = 0; i < LIST_ENTRIES; i++) 
+    {
+        File entry = conn.file().openNextFile();
 
         // done if past last used entry
         if (! entry) 
         {
             // no more files
-            break;
+            client.println("</ul>");
+            return false;
         }
 
         // print any indent spaces
@@ -86,327 +179,735 @@ void ListFiles(EthernetClient client, uint8_t flags, File dir)
         client.println("</li>");
         entry.close();
     }
-    client.println("</ul>");
+    return true;
+}
+
+void bootPhase(PGM_P name)
+{
+    if (bootPhases >= BOOT_PHASES)
+        return;
+
+    uint16_t ms = millis();
+    bootPhaseName[bootPhases] = name;
+    bootPhaseMs[bootPhases] = ms;
+    bootPhases++;
+    DIAG_INFO("Boot: %S done at %u ms", name, ms);
+}
+
+void ntpCallback()
+{
+    // The scheduler owns the cadence; TimeLib keeps counting from millis()
+    // in between and across failed requests
+    PERF_SCOPE(NTP);
+    if (timeClient.forceUpdate())
+        setTime(static_cast<time_t>(timeClient.getEpochTime()));
+}
+
+void rollupCallback()
+{
+    rainGauge.rollup();
+}
+
+void statsCallback()
+{
+    scheduler.printStats(diag);
+    idle.printStats(diag);
+    idle.resetStats();
+    perf.printTable(diag);
+    memory.update();
+    memory.printStats(diag);
+    diag.print(F("diag messages dropped: "));
+    diag.println(diag.dropped());
+}
+
+void inventoryCallback()
+{
+    if (inventory.step(diag, INVENTORY_ENTRIES))
+        return;
+
+    DIAG_INFO("SD inventory: %u files in %u dirs, %lu bytes",
+              inventory.files(), inventory.dirs(), inventory.bytes());
+    scheduler.stop(inventoryTask);
+}
+
+void freeScanCallback()
+{
+    PERF_SCOPE(SD_READ);
+    SdVolume* vol = SD.vol();
+    if (logWriter.cardOk() && vol->freeClusterScan(FREE_SCAN_BLOCKS) &&
+        !vol->freeClusterCountExact())
+        return;
+
+    scheduler.stop(freeScanTask);
+}
+
+// Status and headers of the JSON endpoints; the body follows from
+// HttpConnection::generate()
+void jsonHeaders(HttpConnection& conn)
+{
+    conn.header(PSTR("HTTP/1.1 200 OK"));
+    conn.header(PSTR("Content-Type: application/json"));
+    conn.header(PSTR("Cache-Control: no-store"));
+}
+
+// /debug/stats: the uptime, one part per perf section, then the rest
+bool printStats(HttpConnection& conn, Print& out)
+{
+    uint32_t part = conn.cursor()++;
+    if (part == 0)
+    {
+        out.print(F("{\"uptime_ms\":"));
+        out.print(millis());
+        out.print(F(",\"perf\":{"));
+        return true;
+    }
+    if (part <= PERF_SECTION_COUNT)
+    {
+        if (part > 1)
+            out.print(',');
+        perf.printJson(out, part - 1);
+        return true;
+    }
+    if (part == PERF_SECTION_COUNT + 1)
+    {
+        memory.update();
+        out.print(F("},\"memory\":"));
+        memory.printJson(out);
+        out.print(F(",\"log\":"));
+        logWriter.printJson(out);
+        return true;
+    }
+    if (part == PERF_SECTION_COUNT + 2)
+    {
+        out.print(F(",\"spi\":"));
+        spiBus.printJson(out);
+        out.print(F(",\"http\":"));
+        web.printJson(out);
+        return true;
+    }
+
+    out.print(F(",\"boot\":{"));
+    for (uint8_t i = 0; i < bootPhases; i++)
+    {
+        if (i)
+            out.print(',');
+        out.print('"');
+        out.print(reinterpret_cast<const __FlashStringHelper*>(bootPhaseName[i]));
+        out.print(F("\":"));
+        out.print(bootPhaseMs[i]);
+    }
+    out.print('}');
+    out.println('}');
+    return false;
+}
+
+void debugStats(HttpConnection& conn)
+{
+    jsonHeaders(conn);
+    conn.generate(printStats);
+}
+
+// ----- Channel sample functions (see LogSchema.h), values in fixed point -----
+
+bool tempRequested = false;
+
+bool sampleTemperature(int32_t* value)
+{
+    // Conversions run in the background; read the one requested last time
+    PERF_SCOPE(ONEWIRE);
+    bool valid = false;
+    if (tempRequested)
+    {
+        float t = sensors.getTempCByIndex(0);
+        if (t != DEVICE_DISCONNECTED_C)
+        {
+            *value = lround(t * 100);
+            valid = true;
+        }
+    }
+    sensors.requestTemperatures();
+    tempRequested = true;
+    return valid;
+}
+
+Bmp280Sample baro;
+bool haveBaro = false;
+
+bool samplePressure(int32_t* value)
+{
+    // Result of the conversion triggered last time, then start the next one
+    PERF_SCOPE(I2C);
+    haveBaro = barometer.read(&baro);
+    barometer.trigger();
+    if (haveBaro)
+        *value = baro.pressure / 256;
+    return haveBaro;
+}
+
+// Must follow samplePressure in the table, reuses its reading
+bool sampleBaroTemperature(int32_t* value)
+{
+    *value = baro.temperature;
+    return haveBaro;
+}
+
+// Must follow samplePressure in the table, reuses its reading
+bool sampleHumidity(int32_t* value)
+{
+    *value = (baro.humidity * 100 + 512) / 1024;
+    return haveBaro && barometer.hasHumidity();
+}
+
+WindVaneSample vane;
+bool haveVane = false;
+
+bool sampleWindDirection(int32_t* value)
+{
+    haveVane = windVane.read(&vane);
+    *value = lround(vane.direction * 10);
+    return haveVane;
+}
+
+// Must follow sampleWindDirection in the table, reuses its reading
+bool sampleWindSteadiness(int32_t* value)
+{
+    *value = lround(vane.steadiness * 100);
+    return haveVane;
+}
+
+bool sampleRainTotal(int32_t* value)
+{
+    rainGauge.sample();
+    *value = lround(rainGauge.totalMm() * 100);
+    return true;
 }
 
-void printDirectory(File dir, int numTabs) 
+// rainTotal is only read at log time, so this keeps the rate window moving
+bool sampleRainRate(int32_t* value)
 {
-   while(true) {
-     File entry =  dir.openNextFile();
-     if (! entry) {
-       // no more files
-       break;
-     }
-     for (uint8_t i=0; i<numTabs; i++) {
-       Serial.print('\t');
-     }
-     Serial.print(entry.name());
-     if (entry.isDirectory()) {
-       Serial.println("/");
-       printDirectory(entry, numTabs+1);
-     } else {
-       // files have sizes, directories do not
-       Serial.print("\t\t");
-       Serial.println(entry.size(), DEC);
-     }
-     entry.close();
-   }
+    rainGauge.sample();
+    *value = lround(rainGauge.rateMmPerHour() * 100);
+    return true;
 }
 
-String printDigits(int digits)
+// Latest logged value of every channel, for /api/current
+int32_t current[LOG_CHANNEL_COUNT];
+time_t currentTime;
+
+// "time":...,"temperature":...,... for /api/current and /api/events
+void printReadings(Print& out)
 {
-    String retval = "";
-    // utility for digital clock display: prints preceding colon and leading 0
-    if(digits < 10)
-        retval += "0";
+    out.print(F("\"time\":"));
+    out.print(currentTime);
 
-    retval += digits;
-    return retval;
+#define READINGS_STREAM(Type, File, Id, Fields, LogMs) \
+    Type::fields::printJson(out, current + Type::firstChannel);
+    LOG_STREAMS(READINGS_STREAM)
+#undef READINGS_STREAM
 }
 
-void digitalClockDisplay()
+// The data of an /api/events event
+void printReadingsEvent(Print& out)
 {
-    // digital clock display of the time
-    Serial.print(printDigits(hour()));
-    Serial.print(":");
-    Serial.print(printDigits(minute()));
-    Serial.print(":");     
-    Serial.print(printDigits(second()));
+    out.print('{');
+    printReadings(out);
+    out.print('}');
+}
 
-    Serial.print(" ");
-    Serial.print(printDigits(day()));
-    Serial.print("/");     
-    Serial.print(printDigits(month()));
-    Serial.print("/");
-    Serial.print(year());
+template <typename Stream>
+void logStream(time_t t)
+{
+    int32_t* values = current + Stream::firstChannel;
+    LogStream<Stream>::take(values);
+    logWriter.append<Stream>(t, values);
 }
 
 void sensorCallback()
 {
-    timeClient.update();
-    time_t t = static_cast<time_t>(timeClient.getEpochTime());
-    setTime(t);
-    
-    Serial.print("Log cycle ");
-    digitalClockDisplay();
+    PERF_SCOPE(SENSOR);
+    uint32_t ms = millis();
 
-    String path = "/LOGS/" + String(year());    
-    path += "/" + String(month());
-    path += "/" + String(day());
+    LogStream<TempLog>::poll(ms);
+    LogStream<PressureLog>::poll(ms);
+    LogStream<WindLog>::poll(ms);
+    LogStream<RainLog>::poll(ms);
 
-    if (!SD.exists(path))
-        SD.mkdir(path);
+    time_t t = now();
+    bool logged = false;
+    if (LogStream<TempLog>::due(ms))
+    {
+        logStream<TempLog>(t);
+        logged = true;
+    }
+    if (LogStream<PressureLog>::due(ms))
+    {
+        logStream<PressureLog>(t);
+        logged = true;
+    }
+    if (LogStream<WindLog>::due(ms))
+    {
+        logStream<WindLog>(t);
+        logged = true;
+    }
+    if (LogStream<RainLog>::due(ms))
+    {
+        logStream<RainLog>(t);
+        logged = true;
+    }
 
-    File temps = SD.open(path + "/TEMP.LOG", FILE_WRITE);
-    File press = SD.open(path + "/PRESSURE.LOG", FILE_WRITE);
-    File wind = SD.open(path + "/WIND.LOG", FILE_WRITE);
-    File rain = SD.open(path + "/RAIN.LOG", FILE_WRITE);
+    if (logged)
+    {
+        currentTime = t;
+        web.publish(printReadingsEvent);
+        DIAG_INFO("Log cycle %02d:%02d:%02d %02d/%02d/%d, %u bytes queued",
+                  hour(t), minute(t), second(t), day(t), month(t), year(t), logWriter.queue().bytes());
+    }
 
-    sensors.requestTemperatures(); 
-    
-    float temp = sensors.getTempCByIndex(0);
-    Serial.print("Celsius temperature: ");
-    Serial.print(temp); 
-    Serial.print(" ");
-
-    temps.print(printDigits(hour()));
-    temps.print(":");
-    temps.print(printDigits(minute()));
-    temps.print(":");     
-    temps.print(printDigits(second()));
-    temps.print("   ");
-    temps.println(temp);
-
-    press.print(printDigits(hour()));
-    press.print(":");
-    press.print(printDigits(minute()));
-    press.print(":");     
-    press.print(printDigits(second()));
-    press.println("   TO_BE_IMPLEMENTED");
-
-    wind.print(printDigits(hour()));
-    wind.print(":");
-    wind.print(printDigits(minute()));
-    wind.print(":");     
-    wind.print(printDigits(second()));
-    wind.println("   TO_BE_IMPLEMENTED");
-
-    rain.print(printDigits(hour()));
-    rain.print(":");
-    rain.print(printDigits(minute()));
-    rain.print(":");     
-    rain.print(printDigits(second()));
-    rain.println("   TO_BE_IMPLEMENTED");
-
-    temps.close();
-    press.close();
-    wind.close();
-    rain.close();    
-
-    Serial.print(" logs updated in ");
-    Serial.println(path.c_str());
-}
-
-void webServerCallback()
-{
-    char clientline[BUFSIZ];
-    char name[17];
-    int index = 0;
-    
-    EthernetClient client = server.available();
-    if (client) 
+    // Every tick, so card retries and backlog flushes do not wait for the
+    // next log cycle
+    logWriter.service();
+    if (logWriter.queue().spillPending())
+        scheduler.wake(logSpillTask);
+}
+
+void logSpillCallback()
+{
+    if (!logWriter.spill())
+        scheduler.stop(logSpillTask);
+}
+
+bool printCurrent(HttpConnection& conn, Print& out)
+{
+    out.print('{');
+    printReadings(out);
+    out.print(F(",\"log\":"));
+    logWriter.printJson(out);
+    out.println('}');
+    return false;
+}
+
+void apiCurrent(HttpConnection& conn)
+{
+    jsonHeaders(conn);
+    conn.generate(printCurrent);
+}
+
+// Server-Sent Events: the readings now and after every log cycle, on one
+// connection that stays open instead of a poll of /api/current each time
+void apiEvents(HttpConnection& conn)
+{
+    if (web.subscribe(conn, printReadingsEvent))
+        return;
+
+    conn.header(PSTR("HTTP/1.1 503 Service Unavailable"));
+    conn.header(PSTR("Content-Type: text/plain"));
+    conn.body(PSTR("Too many event streams\r\n"));
+}
+
+bool printStorage(HttpConnection& conn, Print& out)
+{
+    if (!logWriter.cardOk())
+    {
+        out.println(F("{\"card\":false}"));
+        return false;
+    }
+
+    // Everything comes from the mounted volume; no FAT reads here
+    SdVolume* vol = SD.vol();
+    uint16_t clusterKb = vol->blocksPerCluster() / 2;
+    uint32_t clusters = vol->clusterCount();
+    uint32_t freeClusters = vol->freeClusterCount();
+    out.print(F("{\"card\":true,\"fat\":"));
+    out.print(vol->fatType());
+    out.print(F(",\"cluster_bytes\":"));
+    out.print(512UL * vol->blocksPerCluster());
+    out.print(F(",\"capacity_kb\":"));
+    out.print(clusters * clusterKb);
+    if (freeClusters == FSINFO_UNKNOWN)
+        out.print(F(",\"free_kb\":null,\"used_kb\":null"));
+    else
+    {
+        out.print(F(",\"free_kb\":"));
+        out.print(freeClusters * clusterKb);
+        out.print(F(",\"used_kb\":"));
+        out.print((clusters - freeClusters) * clusterKb);
+    }
+    if (!vol->freeClusterCountExact())
+    {
+        // Still counting, any figure above is the FSINFO hint; report how
+        // far the scan has got
+        uint32_t pos = vol->freeClusterScanPosition();
+        out.print(F(",\"scan_pct\":"));
+        out.print(pos ? (pos - 2) / (clusters / 100 + 1) : 0);
+        scheduler.wake(freeScanTask);
+    }
+    out.println('}');
+    return false;
+}
+
+void apiStorage(HttpConnection& conn)
+{
+    jsonHeaders(conn);
+    conn.generate(printStorage);
+}
+
+// /api/days[?year=YYYY], the current year without one, a day per part
+bool printDays(HttpConnection& conn, Print& out)
+{
+    char* year = strstr(conn.request(), "year=");
+    return dayIndex.printJson(out, year ? atoi(year + 5) : 0, conn.file(), conn.cursor());
+}
+
+#ifdef SD_BENCH
+// us for the writes, the single block reads and the stream; 0 writes if
+// the scratch file would not open
+uint32_t sdBenchUs[3];
+
+bool printSdBench(HttpConnection& conn, Print& out)
+{
+    if (!sdBenchUs[0])
+    {
+        out.println(F("{\"error\":\"open\"}"));
+        return false;
+    }
+    out.print(F("{\"blocks\":"));
+    out.print(SD_BENCH_BLOCKS);
+    out.print(F(",\"write_us\":"));
+    out.print(sdBenchUs[0] / SD_BENCH_BLOCKS);
+    out.print(F(",\"read_us\":"));
+    out.print(sdBenchUs[1] / SD_BENCH_BLOCKS);
+    out.print(F(",\"stream_us\":"));
+    out.print(sdBenchUs[2] / SD_BENCH_BLOCKS);
+    out.println('}');
+    return false;
+}
+
+// Card cycles per block: writes through a scratch file, then single block
+// reads and the multiple block stream of the same data. Holds the loop
+// for the whole run, so it is a POST of bench builds only
+void debugSdBench(HttpConnection& conn)
+{
+    jsonHeaders(conn);
+    conn.generate(printSdBench);
+
+    sdBenchUs[0] = 0;
+    File file = SD.open("/BENCH.TMP", O_READ | O_WRITE | O_CREAT | O_TRUNC);
+    if (!file)
+        return;
+
+    uint8_t buf[512];
+    for (uint16_t i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+
+    uint32_t start = micros();
+    for (uint16_t i = 0; i < SD_BENCH_BLOCKS; i++)
+        file.write(buf, sizeof(buf));
+    file.flush();
+    sdBenchUs[0] = micros() - start;
+
+    for (uint8_t pass = 1; pass < 3; pass++)
+    {
+        file.seek(0);
+        start = micros();
+        while ((pass == 1 ? file.read(buf, sizeof(buf)) : file.readStream(buf)) > 0)
+            ;
+        sdBenchUs[pass] = micros() - start;
+    }
+    file.close();
+    SD.remove("/BENCH.TMP");
+}
+#endif
+
+// {{name}} in a template page: the latest logged value of the channel of
+// that name, "--" before it has one, or {{time}} of that log cycle
+bool templateValue(const char* name, Print& out)
+{
+    if (strcmp_P(name, PSTR("time")) == 0)
+    {
+        char text[9];
+        snprintf_P(text, sizeof(text), PSTR("%02d:%02d:%02d"),
+                   hour(currentTime), minute(currentTime), second(currentTime));
+        out.print(currentTime ? text : "--");
+        return true;
+    }
+
+#define TEMPLATE_CHANNEL(Name, Unit, Decimals, Width, Reduce, Sample, SampleMs) \
+    if (strcmp_P(name, Name##Field::name()) == 0) \
+    { \
+        if (current[LOG_CHANNEL_##Name] == LOG_MISSING) \
+            out.print("--"); \
+        else \
+            printFixed(out, current[LOG_CHANNEL_##Name], Decimals); \
+        return true; \
+    }
+#define TEMPLATE_STREAM(Type, File, Id, Fields, LogMs) \
+    Fields(TEMPLATE_CHANNEL)
+    LOG_STREAMS(TEMPLATE_STREAM)
+#undef TEMPLATE_STREAM
+#undef TEMPLATE_CHANNEL
+
+    return false;
+}
+
+// A page from flash; revalidation by ETag costs only the headers. A
+// template shows live values, so it is rendered afresh every time
+void sendAsset(HttpConnection& conn, const WebAsset& asset)
+{
+    if (asset.tmpl)
+    {
+        conn.header(PSTR("HTTP/1.1 200 OK"));
+        conn.header(asset.type);
+        conn.header(PSTR("Cache-Control: no-store"));
+        conn.render((PGM_P)asset.data, asset.length, templateValue);
+        return;
+    }
+
+    if (conn.etagMatches(asset.etag))
+    {
+        conn.notModified();
+        conn.header(asset.etagHeader);
+        return;
+    }
+
+    conn.header(PSTR("HTTP/1.1 200 OK"));
+    conn.header(asset.type);
+    conn.header(asset.etagHeader);
+    if (asset.gzip)
+    {
+        conn.header(PSTR("Content-Encoding: gzip"));
+        conn.header(PSTR("Vary: Accept-Encoding"));
+    }
+    conn.body((PGM_P)asset.data, asset.length);
+}
+
+void handleRequest(HttpConnection& conn)
+{
+    char* clientline = conn.request();
+
+    // Print it out for debugging
+    DIAG_DEBUG("%s", clientline);
+
+#ifdef SD_BENCH
+    if (strncmp_P(clientline, PSTR("POST /debug/sdbench "), 20) == 0)
+    {
+        debugSdBench(conn);
+        return;
+    }
+#endif
+
+    // Look for substring such as a request to get the file
+    if (strstr(clientline, "GET /") != 0) 
     {
-        // reset the input buffer
-        index = 0;
+        // this time no space after the /, so a sub-file!
+        char *filename;
+        
+        filename = clientline + 5; // look after the "GET /" (5 chars)  *******
+        // a little trick, look for the " HTTP/1.1" string and 
+        // turn the first character of the substring into a 0 to clear it out.
+        // An overlong request line lost it to truncation.
+        char* version = strstr(clientline, " HTTP");
+        if (version)
+            version[0] = 0;
+
+        if(filename[strlen(filename)-1] == '/') {  // Trim a directory filename
+            filename[strlen(filename)-1] = 0;        //  as Open throws error with trailing /
+        }
         
-        while (client.connected()) 
+        DIAG_INFO("Web request for: %s", filename);  // print the file we want
+
+        if (strcmp(filename, "debug/stats") == 0)
+        {
+            debugStats(conn);
+            return;
+        }
+
+        if (strcmp(filename, "api/current") == 0)
+        {
+            apiCurrent(conn);
+            return;
+        }
+
+        if (strcmp(filename, "api/events") == 0)
+        {
+            apiEvents(conn);
+            return;
+        }
+
+        if (strcmp(filename, "api/storage") == 0)
+        {
+            apiStorage(conn);
+            return;
+        }
+
+        if (strncmp(filename, "api/days", 8) == 0)
+        {
+            // optional ?year=YYYY, read by printDays()
+            jsonHeaders(conn);
+            conn.generate(printDays);
+            return;
+        }
+
+        // The dashboard pages come from flash; the card's copies are only
+        // for the odd client that cannot take gzip. Their query strings
+        // (HOME.HTM?hash=...) are for the scripts in the page
+        char* query = strchr(filename, '?');
+        if (query)
+            *query = 0;
+
+        WebAsset asset;
+        if (findWebAsset(filename, &asset) && (!asset.gzip || conn.acceptsGzip()))
+        {
+            sendAsset(conn, asset);
+            return;
+        }
+
+        File file;
+        {
+            PERF_SCOPE(SD_OPEN);
+            file = SD.open(filename, O_READ);
+        }
+        if ( file == 0 ) 
+        {  
+            // Opening the file with return code of 0 is an error in SDFile.open
+            conn.header(PSTR("HTTP/1.1 404 Not Found"));
+            conn.header(PSTR("Content-Type: text/html"));
+            conn.body(PSTR("<h2>File Not Found!</h2>\r\n<br><h3>Couldn't open the File!</h3>\r\n"));
+            return; 
+        }
+        
+        DIAG_DEBUG("File download begun...");
+
+        if (String(filename) == "" && SD.exists("/INDEX.HTM"))
         {
-            if (client.available()) 
+            file.close();
             {
-                char c = client.read();
-                
-                // If it isn't a new line, add the character to the buffer
-                if (c != '\n' && c != '\r') 
-                {
-                    clientline[index] = c;
-                    index++;
-                    // are we too big for the buffer? start tossing out data
-                    if (index >= BUFSIZ) 
-                        index = BUFSIZ -1;
-                    
-                    // continue to read more data!
-                    continue;
-                }
-                
-                // got a \n or \r new line, which means the string is done
-                clientline[index] = 0;
-                
-                // Print it out for debugging
-                Serial.println(clientline);
-                
-                // Look for substring such as a request to get the file
-                if (strstr(clientline, "GET /") != 0) 
-                {
-                    // this time no space after the /, so a sub-file!
-                    char *filename;
-                    
-                    filename = clientline + 5; // look after the "GET /" (5 chars)  *******
-                    // a little trick, look for the " HTTP/1.1" string and 
-                    // turn the first character of the substring into a 0 to clear it out.
-                    (strstr(clientline, " HTTP"))[0] = 0;
-            
-                    if(filename[strlen(filename)-1] == '/') {  // Trim a directory filename
-                        filename[strlen(filename)-1] = 0;        //  as Open throws error with trailing /
-                    }
-                    
-                    Serial.print(F("Web request for: ")); Serial.println(filename);  // print the file we want
-            
-                    File file = SD.open(filename, O_READ);
-                    if ( file == 0 ) 
-                    {  
-                        // Opening the file with return code of 0 is an error in SDFile.open
-                        client.println("HTTP/1.1 404 Not Found");
-                        client.println("Content-Type: text/html");
-                        client.println();
-                        client.println("<h2>File Not Found!</h2>");
-                        client.println("<br><h3>Couldn't open the File!</h3>");
-                        break; 
-                    }
-                    
-                    Serial.println("File download begun...");
-                                
-                    client.println("HTTP/1.1 200 OK");
-
-                    if (String(filename) == "" && SD.exists("/INDEX.HTM"))
-                    {
-                        // Any non-directory clicked, server will send file to client for download
-                        client.println("Content-Type: text/html");
-                        client.println();
-
-                        filename = "INDEX.HTM";
-                        file = SD.open(filename, O_READ);
-
-                        char file_buffer[16];
-                        int avail;
-                        while (avail = file.available()) 
-                        {
-                            int to_read = min(avail, 16);
-                            if (to_read != file.read(file_buffer, to_read)) 
-                                break;
-                            
-                            client.write(file_buffer, to_read);
-                        }
-                        file.close();
-                        break;
-                    }
-
-                    if (file.isDirectory()) 
-                    {
-                        Serial.println("is a directory");
-                        client.println("Content-Type: text/html");
-                        client.println();
-                        client.print("<h2>Files in /");
-                        client.print(filename); 
-                        client.println(":</h2>");
-
-                        ListFiles(client,LS_SIZE,file); 
-
-                        file.close();              
-                    } 
-                    else if (String(filename).endsWith(".LOG") || String(filename).endsWith(".TXT"))
-                    {
-                        // Any non-directory clicked, server will send file to client for download
-                        client.println("Content-Type: text/plain");
-                        client.println();
-                    }
-                    else if (String(filename).endsWith(".HTM") || String(filename).endsWith(".HTML"))
-                    {
-                        // Any non-directory clicked, server will send file to client for download
-                        client.println("Content-Type: text/html");
-                        client.println();
-                    }
-                    else 
-                    { 
-                        // Any non-directory clicked, server will send file to client for download
-                        client.println("Content-Type: application/octet-stream");
-                        client.println();
-                    }
-
-                    char file_buffer[16];
-                    int avail;
-                    while (avail = file.available()) 
-                    {
-                        int to_read = min(avail, 16);
-                        if (to_read != file.read(file_buffer, to_read)) 
-                            break;
-                        
-                        client.write(file_buffer, to_read);
-                    }
-                    file.close();
-                } 
-                else 
-                {
-                    // everything else is a 404
-                    client.println("HTTP/1.1 404 Not Found");
-                    client.println("Content-Type: text/html");
-                    client.println();
-                    client.println("<h2>File Not Found!</h2>");
-                }
-                break;
+                PERF_SCOPE(SD_OPEN);
+                file = SD.open("INDEX.HTM", O_READ);
             }
+            conn.header(PSTR("HTTP/1.1 200 OK"));
+            conn.header(PSTR("Content-Type: text/html"));
+            conn.sendFile(file);
+            return;
         }
-        // give the web browser time to receive the data
-        delay(1);
-        client.stop();
+
+        if (file.isDirectory()) 
+        {
+            DIAG_DEBUG("is a directory");
+            conn.header(PSTR("HTTP/1.1 200 OK"));
+            conn.header(PSTR("Content-Type: text/html"));
+            conn.generate(ListFiles, file);
+            return;
+        } 
+
+        // Any non-directory clicked, server will send file to client for download
+        conn.header(PSTR("HTTP/1.1 200 OK"));
+        if (String(filename).endsWith(".LOG") || String(filename).endsWith(".TXT"))
+            conn.header(PSTR("Content-Type: text/plain"));
+        else if (String(filename).endsWith(".HTM") || String(filename).endsWith(".HTML"))
+            conn.header(PSTR("Content-Type: text/html"));
+        else 
+            conn.header(PSTR("Content-Type: application/octet-stream"));
+        conn.sendFile(file);
+    } 
+    else 
+    {
+        // everything else is a 404
+        conn.header(PSTR("HTTP/1.1 404 Not Found"));
+        conn.header(PSTR("Content-Type: text/html"));
+        conn.body(PSTR("<h2>File Not Found!</h2>\r\n"));
     }
 }
 
+void netPollCallback()
+{
+    // Acknowledge first so anything arriving while we serve raises a new edge
+    idle.clearNetworkInterrupts();
+
+    // A response with more to send resumes on the next pass; one waiting
+    // for TX room waits for the W5100's SEND_OK interrupt or the next poll
+    if (web.poll())
+        scheduler.wake(netPollTask);
+}
+
 void setup()
 {
-    Serial.begin(9600);
+    diag.begin(DIAG_BAUD);
     while (!Serial);      // For 32u4 based microcontrollers like 32u4 Adalogger Feather
-    
-    //Serial.print(F("Free RAM: ")); Serial.println(FreeRam());  
-    
-    if (!SD.begin(SDCARD_CS)) 
-    {
-        error("card.init failed!");
-    } 
-    
-    root = SD.open("/");
-    Serial.println(F("Done"));
-    
-    printDirectory(root, 0);
-
-    // Recursive list of all directories
-    Serial.println(F("Files found in all dirs:"));
-    printDirectory(root, 0);
 
-    Serial.println(F("Initializing web server..."));
+    // Network first, so the station answers as early as possible. No extra
+    // delay for the module: Ethernet.begin() already waits out its reset.
     Ethernet.init(WIZ_CS);
-
-    // Give the ethernet module time to boot up
-    delay(1000);
-
-    // Start the Ethernet connection
     Ethernet.begin(mac, ip);
     
     // Print the Ethernet board/shield's IP address to Serial monitor
-    Serial.print(F("Serving on IP address: "));
-    Serial.println(Ethernet.localIP());
+    IPAddress local = Ethernet.localIP();
+    DIAG_INFO("Serving on IP address: %u.%u.%u.%u", local[0], local[1], local[2], local[3]);
     server.begin();
-
-    // Begin sensor reading thread
-    sensorReader.onRun(sensorCallback);
-	sensorReader.setInterval(10000);
+    idle.begin(ETH_INT_PIN);
+    bootPhase(PSTR("network"));
+
+    // Without a card the station keeps measuring and serving; records
+    // queue up until the writer finds one
+    bool card = SD.begin(SDCARD_CS);
+    if (!card)
+        DIAG_WARN("SD card init failed, logging to RAM");
+    logWriter.begin(SDCARD_CS, card, &dayIndex);
+    for (uint8_t i = 0; i < LOG_CHANNEL_COUNT; i++)
+        current[i] = LOG_MISSING;
+    bootPhase(PSTR("sd"));
 
     timeClient.begin();
+
+    sensors.begin();
+    sensors.setWaitForConversion(false);
+
+    rainGauge.begin(RAIN_PIN);
+    windVane.begin(WIND_VANE_CHANNEL);
+
+    baroBus.begin();
+    if (barometer.begin(&baroBus, BARO_ADDR))
+    {
+        barometer.configure(BARO_OSRS_T, BARO_OSRS_P, BARO_OSRS_H, BARO_FILTER);
+        barometer.trigger();
+    }
+    else
+        DIAG_WARN("No BMP280/BME280 found");
+    bootPhase(PSTR("sensors"));
+
+    // NTP first so the first log cycle has a valid clock
+    scheduler.add(PSTR("ntp"), ntpCallback, NTP_INTERVAL);
+    scheduler.add(PSTR("sensor"), sensorCallback, SENSOR_INTERVAL, SENSOR_INTERVAL);
+    scheduler.add(PSTR("rollup"), rollupCallback, ROLLUP_INTERVAL, ROLLUP_INTERVAL);
+    netPollTask = scheduler.add(PSTR("netpoll"), netPollCallback, NET_POLL_INTERVAL);
+    scheduler.add(PSTR("stats"), statsCallback, STATS_INTERVAL, STATS_INTERVAL);
+
+    // Runs in slices between the other tasks and stops itself when done
+    inventoryTask = scheduler.add(PSTR("inventory"), inventoryCallback, INVENTORY_INTERVAL);
+    if (SD_INVENTORY && card)
+    {
+        DIAG_INFO("Files found in all dirs:");
+        inventory.begin("/");
+    }
+    else
+        scheduler.stop(inventoryTask);
+    freeScanTask = scheduler.add(PSTR("freescan"), freeScanCallback, FREE_SCAN_INTERVAL);
+    logSpillTask = scheduler.add(PSTR("logspill"), logSpillCallback, LOG_SPILL_INTERVAL);
+    scheduler.stop(logSpillTask);
+    bootPhase(PSTR("tasks"));
+
+    memory.update();
+    memory.printStats(diag);
 }
  
 void loop()
 {
-	if(sensorReader.shouldRun())
-		sensorReader.run();
+    if (idle.takeNetworkEvent())
+        scheduler.wake(netPollTask);
+
+    scheduler.run();
+
+    diag.drain();
 
-    webServerCallback();
+    // Returns early (without consuming it) when an Ethernet interrupt is pending
+    idle.sleepFor(scheduler.timeUntilNext());
 }
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef HostArduino_h
+#define HostArduino_h
+
+/*
+    Just enough of the Arduino core for the native test env (see
+    platformio.ini) to build the firmware modules that do not touch the
+    hardware. PROGMEM data is plain memory here, so the *_P functions are
+    their RAM counterparts.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef uint8_t byte;
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+
+// millis() is whatever the test sets it to
+extern uint32_t hostMillis;
+inline uint32_t millis() { return hostMillis; }
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size)
+    {
+        size_t n = 0;
+        while (size--)
+            n += write(*buf++);
+        return n;
+    }
+    size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t write(const char* buf, size_t size) { return write((const uint8_t*)buf, size); }
+
+    size_t print(const char* s) { return write(s); }
+    size_t print(const __FlashStringHelper* s) { return write((const char*)s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(int value) { return print((long)value); }
+    size_t print(unsigned int value) { return print((unsigned long)value); }
+    size_t print(unsigned char value) { return print((unsigned long)value); }
+
+    template <typename T> size_t println(T value) { return print(value) + print("\r\n"); }
+    size_t println() { return print("\r\n"); }
+
+    int getWriteError() { return writeError_; }
+    void clearWriteError() { writeError_ = 0; }
+
+protected:
+    void setWriteError(int err = 1) { writeError_ = err; }
+
+private:
+    int writeError_ = 0;
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#include <stdarg.h>
+
+inline size_t Print::printf(const char* format, ...)
+{
+    char text[24];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    return write(text);
+}
+
+// Serial output goes to stdout
+class HardwareSerial : public Print
+{
+public:
+    size_t write(uint8_t c) override { return putchar(c) == EOF ? 0 : 1; }
+    using Print::write;
+};
+
+static HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef FakeBmp280Bus_h
+#define FakeBmp280Bus_h
+
+#include "Bmp280.h"
+
+/*
+    A BMP280/BME280 at the register level, for the native tests.
+
+    Registers are a plain 256 byte map the test fills in: chip id,
+    calibration and the raw ADC values, set with setCalibration() and
+    setAdc(). A forced mode write to ctrl_meas starts a "conversion":
+    status reports measuring for conversionReads status reads, then the
+    mode bits fall back to sleep as on the real part. Every bus access is
+    counted, so a test can check the driver reads the data in one burst.
+*/
+class FakeBmp280Bus : public Bmp280Bus
+{
+public:
+    static const uint8_t REG_CALIB_TP = 0x88;
+    static const uint8_t REG_ID = 0xD0;
+    static const uint8_t REG_STATUS = 0xF3;
+    static const uint8_t REG_CTRL_MEAS = 0xF4;
+    static const uint8_t REG_DATA = 0xF7;
+
+    uint8_t regs[256];
+    uint8_t address;
+    uint8_t conversionReads;    // status reads that still see measuring
+    unsigned reads;
+    unsigned writes;
+    unsigned forced;            // conversions started
+
+    FakeBmp280Bus(uint8_t addr, uint8_t chipId)
+        : address(addr), conversionReads(0), reads(0), writes(0), forced(0), measuring_(0)
+    {
+        memset(regs, 0, sizeof(regs));
+        regs[REG_ID] = chipId;
+    }
+
+    // dig_T1..dig_T3, dig_P1..dig_P9 as in the datasheet, little endian
+    void setCalibration(const int32_t* dig)
+    {
+        for (uint8_t i = 0; i < 12; i++)
+        {
+            regs[REG_CALIB_TP + 2 * i] = dig[i] & 0xFF;
+            regs[REG_CALIB_TP + 2 * i + 1] = (dig[i] >> 8) & 0xFF;
+        }
+    }
+
+    // 20 bit raw pressure and temperature as the data registers hold them
+    void setAdc(uint32_t adcP, uint32_t adcT)
+    {
+        regs[REG_DATA + 0] = adcP >> 12;
+        regs[REG_DATA + 1] = adcP >> 4;
+        regs[REG_DATA + 2] = (adcP & 0x0F) << 4;
+        regs[REG_DATA + 3] = adcT >> 12;
+        regs[REG_DATA + 4] = adcT >> 4;
+        regs[REG_DATA + 5] = (adcT & 0x0F) << 4;
+    }
+
+    bool writeRegister(uint8_t addr, uint8_t reg, uint8_t value) override
+    {
+        if (addr != address)
+            return false;
+        writes++;
+        regs[reg] = value;
+        if (reg == REG_CTRL_MEAS && (value & 0x03) == 0x01)
+        {
+            forced++;
+            measuring_ = conversionReads;
+        }
+        return true;
+    }
+
+    bool readRegisters(uint8_t addr, uint8_t reg, uint8_t* buf, uint8_t len) override
+    {
+        if (addr != address)
+            return false;
+        reads++;
+        if (reg == REG_STATUS)
+        {
+            if (measuring_)
+            {
+                measuring_--;
+                regs[REG_STATUS] = 0x08;
+            }
+            else
+            {
+                // Conversion done: back to sleep mode
+                regs[REG_STATUS] = 0;
+                regs[REG_CTRL_MEAS] &= ~0x03;
+            }
+        }
+        for (uint8_t i = 0; i < len; i++)
+            buf[i] = regs[(uint8_t)(reg + i)];
+        return true;
+    }
+
+private:
+    uint8_t measuring_;
+};
+
+#endif
@@ -0,0 +1,7 @@
+#ifndef HostPrint_h
+#define HostPrint_h
+
+// Print lives in the host Arduino.h
+#include <Arduino.h>
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef SdImageCard_h
+#define SdImageCard_h
+
+#include <Arduino.h>
+#include <vector>
+
+/*
+    Sd2Card for native builds: the card is a disk image in RAM, and
+    SdVolume/SdFile run on it unchanged (lib/SD-1.2.4 picks this header
+    instead of its SPI driver when ARDUINO is not defined).
+
+    It keeps the driver's command behaviour: readBlock() and readData()
+    are one CMD17 each, readStream() keeps a CMD18 open while the blocks
+    asked for follow on, and any other command first ends it with CMD12.
+    The counters record what would have crossed the bus, which is what a
+    benchmark can model timing from.
+*/
+class Sd2Card
+{
+public:
+    std::vector<uint8_t> image;
+
+    // Commands and data blocks that would have gone over the bus
+    unsigned long singleReads;      // CMD17
+    unsigned long streamStarts;     // CMD18
+    unsigned long streamStops;      // CMD12
+    unsigned long writes;           // CMD24
+    unsigned long blocksRead;       // by either read command
+    unsigned long streamBlocks;     // of those, within a CMD18
+
+    Sd2Card() { resetCounters(); }
+
+    void resetCounters()
+    {
+        singleReads = streamStarts = streamStops = writes = blocksRead = streamBlocks = 0;
+        readNext_ = 0;
+    }
+
+    uint32_t cardSize() const { return image.size() / 512; }
+
+    uint8_t readBlock(uint32_t block, uint8_t* dst)
+    {
+        return readData(block, 0, 512, dst);
+    }
+
+    uint8_t readData(uint32_t block, uint16_t offset, uint16_t count, uint8_t* dst)
+    {
+        if (!valid(block) || offset + count > 512)
+            return false;
+        readStop();
+        singleReads++;
+        blocksRead++;
+        memcpy(dst, &image[block * 512UL + offset], count);
+        return true;
+    }
+
+    uint8_t readStream(uint32_t block, uint8_t* dst)
+    {
+        if (!valid(block))
+            return false;
+        if (!readNext_ || block != readNext_)
+        {
+            readStop();
+            streamStarts++;
+        }
+        else
+            streamBlocks++;
+        blocksRead++;
+        memcpy(dst, &image[block * 512UL], 512);
+        readNext_ = block + 1;
+        return true;
+    }
+
+    uint8_t readStop()
+    {
+        if (readNext_)
+        {
+            readNext_ = 0;
+            streamStops++;
+        }
+        return true;
+    }
+
+    uint8_t writeBlock(uint32_t block, const uint8_t* src, uint8_t blocking = 1)
+    {
+        (void)blocking;
+        if (!valid(block))
+            return false;
+        readStop();
+        writes++;
+        memcpy(&image[block * 512UL], src, 512);
+        return true;
+    }
+
+    uint8_t isBusy() { return false; }
+
+private:
+    uint32_t readNext_;
+
+    bool valid(uint32_t block) const { return block < cardSize(); }
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include <unity.h>
+
+#include "Bmp280.h"
+#include "FakeBmp280Bus.h"
+
+#define ADDR 0x76
+
+// Calibration and raw values of the BMP280 datasheet's compensation
+// example (dig_T1..dig_T3, dig_P1..dig_P9)
+static const int32_t exampleDig[12] = {
+    27504, 26435, -1000,
+    36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000
+};
+#define EXAMPLE_ADC_T 519888
+#define EXAMPLE_ADC_P 415148
+
+static FakeBmp280Bus bus(ADDR, BMP280_CHIP_ID);
+static Bmp280 sensor;
+
+void setUp()
+{
+    bus = FakeBmp280Bus(ADDR, BMP280_CHIP_ID);
+    bus.setCalibration(exampleDig);
+    bus.setAdc(EXAMPLE_ADC_P, EXAMPLE_ADC_T);
+}
+
+void tearDown()
+{
+}
+
+static void test_rejects_unknown_chip()
+{
+    bus.regs[FakeBmp280Bus::REG_ID] = 0x55;
+    TEST_ASSERT_FALSE(sensor.begin(&bus, ADDR));
+    TEST_ASSERT_FALSE(sensor.present());
+    TEST_ASSERT_FALSE(sensor.trigger());
+}
+
+static void test_datasheet_example()
+{
+    TEST_ASSERT_TRUE(sensor.begin(&bus, ADDR));
+    TEST_ASSERT_FALSE(sensor.hasHumidity());
+    TEST_ASSERT_TRUE(sensor.trigger());
+
+    Bmp280Sample sample;
+    TEST_ASSERT_TRUE(sensor.read(&sample));
+
+    // 25.08 degC; 100653.27 Pa with the floating point formulas
+    TEST_ASSERT_EQUAL_INT32(2508, sample.temperature);
+    TEST_ASSERT_UINT32_WITHIN(256 / 4, (uint32_t)(100653.27 * 256), sample.pressure);
+}
+
+static void test_read_waits_for_conversion()
+{
+    bus.conversionReads = 2;
+    TEST_ASSERT_TRUE(sensor.begin(&bus, ADDR));
+    TEST_ASSERT_TRUE(sensor.trigger());
+
+    // Busy: read() gives up at once instead of waiting
+    Bmp280Sample sample;
+    TEST_ASSERT_FALSE(sensor.read(&sample));
+    TEST_ASSERT_FALSE(sensor.read(&sample));
+
+    // Status, then every data register in one burst
+    unsigned reads = bus.reads;
+    TEST_ASSERT_TRUE(sensor.read(&sample));
+    TEST_ASSERT_EQUAL_UINT(2, bus.reads - reads);
+    TEST_ASSERT_EQUAL_INT32(2508, sample.temperature);
+
+    // One sample per trigger
+    TEST_ASSERT_FALSE(sensor.read(&sample));
+}
+
+static void test_configure_sets_oversampling_and_filter()
+{
+    TEST_ASSERT_TRUE(sensor.begin(&bus, ADDR));
+    sensor.configure(BMP280_OSRS_X2, BMP280_OSRS_X16, BMP280_OSRS_X1, BMP280_FILTER_4);
+    TEST_ASSERT_EQUAL_HEX8(BMP280_FILTER_4 << 2, bus.regs[0xF5]);
+    TEST_ASSERT_EQUAL_HEX8(0, bus.regs[FakeBmp280Bus::REG_CTRL_MEAS] & 0x03);
+
+    TEST_ASSERT_TRUE(sensor.trigger());
+    TEST_ASSERT_EQUAL_HEX8((BMP280_OSRS_X2 << 5) | (BMP280_OSRS_X16 << 2) | 0x01,
+                           bus.regs[FakeBmp280Bus::REG_CTRL_MEAS]);
+    TEST_ASSERT_EQUAL_UINT(1, bus.forced);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_unknown_chip);
+    RUN_TEST(test_datasheet_example);
+    RUN_TEST(test_read_waits_for_conversion);
+    RUN_TEST(test_configure_sets_oversampling_and_filter);
+    return UNITY_END();
+}
@@ -0,0 +1,212 @@
+#include <unity.h>
+
+#include <vector>
+
+// The FAT code of the card library, on a card image (test/host/SdImageCard.h)
+#include "SdFat.h"
+#include "../../lib/SD-1.2.4/src/utility/SdVolume.cpp"
+#include "../../lib/SD-1.2.4/src/utility/SdFile.cpp"
+
+/*
+    Sustained read throughput of SdFile::readStream() against block by
+    block read() over a FAT16 card image, the layout of the 2 GB and
+    smaller cards the station takes.
+
+    The day files are written the way the logger writes them: several
+    files growing at once, so their cluster chains interleave. The image
+    counts the commands and blocks that would cross the bus; the time
+    per transfer below turns that into throughput. The counts are exact,
+    the times are typical figures for a card on the AVR at SPI F_CPU/2.
+*/
+
+// One byte through the unrolled SPDR loops at 8 MHz
+#define MODEL_BYTE_US 1.1
+// Command frame and R1 response
+#define MODEL_COMMAND_US (8 * MODEL_BYTE_US)
+// From a read command to the first data token
+#define MODEL_ACCESS_US 250.0
+// Between the blocks of a CMD18
+#define MODEL_NEXT_US 10.0
+// CMD12 and the busy wait after it
+#define MODEL_STOP_US 30.0
+// Data token, 512 bytes and the CRC
+#define MODEL_BLOCK_US ((1 + 512 + 2) * MODEL_BYTE_US)
+
+#define BLOCKS_PER_CLUSTER 8
+#define CLUSTERS 6000
+#define ROOT_ENTRIES 512
+#define FAT_BLOCKS ((CLUSTERS + 2) * 2 / 512 + 1)
+#define DATA_START (1 + 2 * FAT_BLOCKS + ROOT_ENTRIES * 32 / 512)
+
+#define FILE_BYTES 300000UL
+#define APPEND_BYTES 2000
+
+static Sd2Card card;
+static SdVolume volume;
+static SdFile root;
+static std::vector<uint8_t> content;
+
+static void format()
+{
+    card.image.assign((DATA_START + CLUSTERS * BLOCKS_PER_CLUSTER) * 512UL, 0);
+
+    bpb_t& bpb = reinterpret_cast<fbs_t*>(&card.image[0])->bpb;
+    bpb.bytesPerSector = 512;
+    bpb.sectorsPerCluster = BLOCKS_PER_CLUSTER;
+    bpb.reservedSectorCount = 1;
+    bpb.fatCount = 2;
+    bpb.rootDirEntryCount = ROOT_ENTRIES;
+    bpb.totalSectors16 = card.cardSize();
+    bpb.sectorsPerFat16 = FAT_BLOCKS;
+    card.image[510] = 0x55;
+    card.image[511] = 0xAA;
+
+    for (uint8_t fat = 0; fat < 2; fat++)
+    {
+        uint8_t* p = &card.image[(1 + fat * FAT_BLOCKS) * 512UL];
+        p[0] = 0xF8;
+        p[1] = p[2] = p[3] = 0xFF;
+    }
+}
+
+// Two day files written in turns, then one written alone
+static void writeFiles()
+{
+    SdFile a, b, c;
+    TEST_ASSERT_TRUE(a.open(&root, "TEMP.LOG", O_CREAT | O_RDWR));
+    TEST_ASSERT_TRUE(b.open(&root, "DATA.BIN", O_CREAT | O_RDWR));
+    for (uint32_t pos = 0; pos < FILE_BYTES; pos += APPEND_BYTES)
+    {
+        uint16_t n = FILE_BYTES - pos < APPEND_BYTES ? FILE_BYTES - pos : APPEND_BYTES;
+        TEST_ASSERT_EQUAL_INT(n, a.write(&content[pos], n));
+        TEST_ASSERT_EQUAL_INT(n, b.write(&content[pos], n));
+    }
+    TEST_ASSERT_TRUE(a.close());
+    TEST_ASSERT_TRUE(b.close());
+
+    TEST_ASSERT_TRUE(c.open(&root, "INDEX.HTM", O_CREAT | O_RDWR));
+    for (uint32_t pos = 0; pos < FILE_BYTES; pos += 30000)
+        TEST_ASSERT_EQUAL_INT(30000, c.write(&content[pos], 30000));
+    TEST_ASSERT_TRUE(c.close());
+}
+
+struct ReadResult
+{
+    std::vector<uint8_t> data;
+    unsigned long commands;     // read commands, CMD12 included
+    double us;                  // modelled bus time
+};
+
+static ReadResult readFile(const char* name, bool stream)
+{
+    SdFile file;
+    TEST_ASSERT_TRUE(file.open(&root, name, O_READ));
+
+    ReadResult r;
+    uint8_t buf[512];
+    int16_t got;
+    card.resetCounters();
+    while ((got = stream ? file.readStream(buf) : file.read(buf, sizeof(buf))) > 0)
+        r.data.insert(r.data.end(), buf, buf + got);
+    TEST_ASSERT_EQUAL_INT(0, got);
+    card.readStop();
+    file.close();
+
+    unsigned long starts = card.singleReads + card.streamStarts;
+    r.commands = starts + card.streamStops;
+    r.us = starts * (MODEL_COMMAND_US + MODEL_ACCESS_US) +
+           card.streamStops * MODEL_STOP_US +
+           card.streamBlocks * MODEL_NEXT_US +
+           card.blocksRead * MODEL_BLOCK_US;
+    return r;
+}
+
+static void report(const char* name, const ReadResult& blocks, const ReadResult& stream)
+{
+    char text[160];
+    snprintf(text, sizeof(text),
+             "%s: read() %lu commands, %.0f kB/s; readStream() %lu commands, %.0f kB/s",
+             name, blocks.commands, FILE_BYTES / blocks.us * 1000,
+             stream.commands, FILE_BYTES / stream.us * 1000);
+    TEST_MESSAGE(text);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+// Runs first: the image the other tests read
+static void test_write_files()
+{
+    format();
+    TEST_ASSERT_TRUE(volume.init(&card, 0));
+    TEST_ASSERT_EQUAL_UINT8(16, volume.fatType());
+    TEST_ASSERT_TRUE(root.openRoot(&volume));
+    writeFiles();
+}
+
+static void test_interleaved_day_file()
+{
+    ReadResult blocks = readFile("TEMP.LOG", false);
+    ReadResult stream = readFile("TEMP.LOG", true);
+    TEST_ASSERT_TRUE(blocks.data == content);
+    TEST_ASSERT_TRUE(stream.data == content);
+    report("interleaved day file", blocks, stream);
+
+    // The chain alternates with DATA.BIN every cluster or two: at worst
+    // one CMD18 and one CMD12 per cluster, plus the FAT reads
+    unsigned long clusters = (FILE_BYTES + 512 * BLOCKS_PER_CLUSTER - 1) / (512 * BLOCKS_PER_CLUSTER);
+    TEST_ASSERT_LESS_OR_EQUAL(3 * clusters, stream.commands);
+    TEST_ASSERT_LESS_THAN(blocks.us, stream.us);
+}
+
+static void test_contiguous_file()
+{
+    ReadResult blocks = readFile("INDEX.HTM", false);
+    ReadResult stream = readFile("INDEX.HTM", true);
+    TEST_ASSERT_TRUE(blocks.data == content);
+    TEST_ASSERT_TRUE(stream.data == content);
+    report("contiguous file", blocks, stream);
+
+    // A single run: one CMD18, restarted only where the chain crosses into
+    // the next FAT block and that has to be read
+    TEST_ASSERT_LESS_OR_EQUAL(2, card.streamStarts);
+    TEST_ASSERT_LESS_THAN(blocks.us * 3 / 4, stream.us);
+}
+
+static void test_unaligned_start_and_tail()
+{
+    SdFile file;
+    TEST_ASSERT_TRUE(file.open(&root, "TEMP.LOG", O_READ));
+
+    // readStream() finishes a partial block first, then goes block-wise
+    std::vector<uint8_t> data(10);
+    TEST_ASSERT_EQUAL_INT(10, file.read(&data[0], 10));
+    uint8_t buf[512];
+    int16_t got;
+    while ((got = file.readStream(buf)) > 0)
+    {
+        TEST_ASSERT_TRUE(got == 512 - 10 || got == 512 || data.size() + got == FILE_BYTES);
+        data.insert(data.end(), buf, buf + got);
+    }
+    file.close();
+    TEST_ASSERT_TRUE(data == content);
+}
+
+int main()
+{
+    content.resize(FILE_BYTES);
+    for (uint32_t i = 0; i < FILE_BYTES; i++)
+        content[i] = i * 7 + (i >> 9);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_write_files);
+    RUN_TEST(test_interleaved_day_file);
+    RUN_TEST(test_contiguous_file);
+    RUN_TEST(test_unaligned_start_and_tail);
+    return UNITY_END();
+}
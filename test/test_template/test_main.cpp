@@ -0,0 +1,138 @@
+#include <unity.h>
+
+#include <string>
+
+#include "Template.h"
+
+struct StringPrint : public Print
+{
+    std::string text;
+
+    size_t write(uint8_t c) override
+    {
+        text += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t* buf, size_t size) override
+    {
+        text.append((const char*)buf, size);
+        return size;
+    }
+    using Print::write;
+};
+
+// Far longer than any buffer on the way: the renderer must not hold it
+static std::string longValue(1000, 'v');
+
+static bool resolve(const char* name, Print& out)
+{
+    if (strcmp(name, "temperature") == 0)
+        out.print("21.37");
+    else if (strcmp(name, "a_1") == 0)
+        out.print('X');
+    else if (strcmp(name, "long") == 0)
+        out.print(longValue.c_str());
+    else
+        return false;
+    return true;
+}
+
+// The page written in three pieces cut at a and b
+static std::string render(const std::string& page, size_t a, size_t b)
+{
+    TemplateRenderer renderer;
+    StringPrint out;
+    const uint8_t* p = (const uint8_t*)page.data();
+    renderer.begin(resolve);
+    renderer.write(p, a, out);
+    renderer.write(p + a, b - a, out);
+    renderer.write(p + b, page.size() - b, out);
+    renderer.end(out);
+    return out.text;
+}
+
+// Same output for every way of cutting the page in three
+static void check(const char* page, const std::string& expected)
+{
+    std::string text(page);
+    for (size_t a = 0; a <= text.size(); a++)
+    {
+        for (size_t b = a; b <= text.size(); b++)
+        {
+            char where[64];
+            snprintf(where, sizeof(where), "\"%s\" cut at %zu, %zu", page, a, b);
+            TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.c_str(), render(text, a, b).c_str(), where);
+        }
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_plain_text()
+{
+    check("", "");
+    check("<p>no placeholders</p>", "<p>no placeholders</p>");
+}
+
+static void test_placeholders_split_anywhere()
+{
+    check("T={{temperature}} C", "T=21.37 C");
+    check("{{temperature}}{{a_1}}", "21.37X");
+    check("{{a_1}}{{a_1}}{{a_1}}", "XXX");
+}
+
+static void test_unknown_names_stay()
+{
+    check("{{nope}} {{temperature}}", "{{nope}} 21.37");
+    check("{{Temperature}}", "{{Temperature}}");
+}
+
+static void test_stray_braces_stay()
+{
+    check("{ {{ {{}} {{a b}} {x}", "{ {{ {{}} {{a b}} {x}");
+    check("{{temperature}", "{{temperature}");
+    check("{{temperature}x}}", "{{temperature}x}}");
+    check("function f() {{ return 1; }}", "function f() {{ return 1; }}");
+    check("{{{temperature}}}", "{21.37}");
+}
+
+static void test_page_ending_inside_placeholder()
+{
+    check("end {", "end {");
+    check("end {{", "end {{");
+    check("end {{temp", "end {{temp");
+    check("end {{a_1}", "end {{a_1}");
+}
+
+static void test_names_longer_than_the_buffer_stay()
+{
+    // TEMPLATE_NAME_MAX - 1 characters is the longest name looked up
+    check("{{abcdefghijklmno}}", "{{abcdefghijklmno}}");
+    check("{{abcdefghijklmnop}}", "{{abcdefghijklmnop}}");
+    check("{{abcdefghijklmnopqrstuvwxyz}}", "{{abcdefghijklmnopqrstuvwxyz}}");
+}
+
+static void test_values_longer_than_the_buffer()
+{
+    check("[{{long}}]", "[" + longValue + "]");
+    check("{{long}}{{long}}", longValue + longValue);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_plain_text);
+    RUN_TEST(test_placeholders_split_anywhere);
+    RUN_TEST(test_unknown_names_stay);
+    RUN_TEST(test_stray_braces_stay);
+    RUN_TEST(test_page_ending_inside_placeholder);
+    RUN_TEST(test_names_longer_than_the_buffer_stay);
+    RUN_TEST(test_values_longer_than_the_buffer);
+    return UNITY_END();
+}
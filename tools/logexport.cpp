@@ -0,0 +1,168 @@
+/*
+    logexport - turn the station's day logs into CSV on a PC.
+
+    Uses the same include/LogSchema.h as the firmware, so the record
+    layouts never drift apart. Build from the repository root:
+
+        g++ -std=c++11 -O2 -Iinclude -o logexport tools/logexport.cpp
+
+    Usage:
+
+        logexport DATA.BIN <stream>     binary records of one stream
+        logexport <stream file>         a text log, e.g. LOGS/2020/5/3/TEMP.LOG
+
+    where <stream> is a log file name from the schema (TEMP.LOG, ...).
+    Binary records carry full unix timestamps; text logs only the time of
+    day.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <strings.h>
+
+#include "LogSchema.h"
+
+// Just enough of Arduino's Print for the schema's printing templates
+struct StdoutPrint
+{
+    void print(char c) { putchar(c); }
+    void print(const char* s) { fputs(s, stdout); }
+    void print(unsigned long v) { printf("%lu", v); }
+};
+
+static StdoutPrint out;
+
+static void printUnixTime(uint32_t t)
+{
+    time_t tt = t;
+    struct tm tm;
+    gmtime_r(&tt, &tm);
+    printf("%04d-%02d-%02d %02d:%02d:%02d",
+           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+static void printCsvValues(const int32_t* values, uint8_t count, const uint8_t* decimals)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        putchar(',');
+        if (values[i] != LOG_MISSING)
+            printFixed(out, values[i], decimals[i]);
+    }
+    putchar('\n');
+}
+
+template <typename Fields> struct Decimals;
+template <typename... F> struct Decimals<FieldList<F...> >
+{
+    static const uint8_t* get()
+    {
+        static const uint8_t d[] = { F::decimals..., 0 };
+        return d;
+    }
+};
+
+template <typename Stream>
+static int exportBinary(FILE* f)
+{
+    Stream::printHeader(out);
+    putchar('\n');
+
+    uint8_t buf[256];
+    int32_t values[Stream::fieldCount];
+    long skipped = 0;
+    int c;
+    while ((c = fgetc(f)) != EOF)
+    {
+        uint8_t size = logRecordSize(c);
+        if (!size)
+        {
+            // not a record start; resynchronise byte by byte
+            skipped++;
+            continue;
+        }
+
+        buf[0] = c;
+        size_t got = fread(buf + 1, 1, size - 1, f);
+        if (got != (size_t)(size - 1) || !logRecordValid(buf))
+        {
+            // torn or damaged record; step back and resynchronise
+            fseek(f, -(long)got, SEEK_CUR);
+            skipped++;
+            continue;
+        }
+
+        uint32_t t;
+        if (!Stream::decode(buf, &t, values))
+            continue;   // another stream's record
+
+        printUnixTime(t);
+        printCsvValues(values, Stream::fieldCount, Decimals<typename Stream::fields>::get());
+    }
+
+    if (skipped)
+        fprintf(stderr, "skipped %ld unrecognised bytes\n", skipped);
+    return 0;
+}
+
+template <typename Stream>
+static int exportText(FILE* f)
+{
+    Stream::printHeader(out);
+    putchar('\n');
+
+    char line[256];
+    int32_t values[Stream::fieldCount];
+    long bad = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        uint32_t t;
+        if (!Stream::parseText(line, &t, values))
+        {
+            bad++;
+            continue;
+        }
+
+        printf("%02u:%02u:%02u", t / 3600, t / 60 % 60, t % 60);
+        printCsvValues(values, Stream::fieldCount, Decimals<typename Stream::fields>::get());
+    }
+
+    if (bad)
+        fprintf(stderr, "skipped %ld unparsable lines\n", bad);
+    return 0;
+}
+
+static const char* baseName(const char* path)
+{
+    const char* slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "usage: %s DATA.BIN <stream> | %s <stream file>\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    bool binary = argc == 3;
+    const char* stream = binary ? argv[2] : baseName(argv[1]);
+
+    FILE* f = fopen(argv[1], binary ? "rb" : "r");
+    if (!f)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+#define EXPORT_STREAM(Type, File, Id, Fields, LogMs) \
+    if (strcasecmp(stream, File) == 0) \
+        return binary ? exportBinary<Type>(f) : exportText<Type>(f);
+    LOG_STREAMS(EXPORT_STREAM)
+#undef EXPORT_STREAM
+
+    fprintf(stderr, "unknown stream %s\n", stream);
+    return 1;
+}
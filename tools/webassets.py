@@ -0,0 +1,126 @@
+"""
+webassets - compile the dashboard pages in sd-card/ into flash.
+
+Writes src/WebAssetData.h: one PROGMEM byte array per file, gzipped when
+that makes it smaller, with its Content-Type and ETag header lines and
+the route table src/WebAssets.cpp searches. The ETag is the FNV-1a hash
+of the bytes served, so it only changes with the content.
+
+Files with {{name}} placeholders are templates, rendered with the live
+values on every request: they are stored as they are, never gzipped.
+
+Runs before every PlatformIO build (extra_scripts in platformio.ini) and
+only rewrites the header when its content changed. Set
+custom_webassets_gzip = no in platformio.ini to store the files as they
+are. It also runs by hand from the repository root:
+
+    python3 tools/webassets.py [--no-gzip]
+"""
+
+import gzip
+import os
+import sys
+
+CONTENT_TYPES = {
+    ".htm": "text/html",
+    ".html": "text/html",
+    ".css": "text/css",
+    ".js": "application/javascript",
+    ".json": "application/json",
+    ".txt": "text/plain",
+    ".png": "image/png",
+    ".ico": "image/x-icon",
+}
+
+# Requests for "/" get this file
+INDEX = "INDEX.HTM"
+
+
+def fnv1a(data):
+    h = 0x811C9DC5
+    for b in bytearray(data):
+        h = ((h ^ b) * 0x01000193) & 0xFFFFFFFF
+    return h
+
+
+def c_name(name):
+    return "".join(c if c.isalnum() else "_" for c in name)
+
+
+def generate(root, use_gzip):
+    src = os.path.join(root, "sd-card")
+    names = sorted(n for n in os.listdir(src) if os.path.isfile(os.path.join(src, n)))
+
+    out = [
+        "// Generated by tools/webassets.py from sd-card/, do not edit",
+        "",
+    ]
+    routes = []
+    total = 0
+    for name in names:
+        with open(os.path.join(src, name), "rb") as f:
+            data = f.read()
+
+        template = b"{{" in data
+        zipped = False
+        if use_gzip and not template:
+            # mtime=0 keeps the output, and so the ETag, reproducible
+            packed = gzip.compress(data, 9, mtime=0)
+            if len(packed) < len(data):
+                data = packed
+                zipped = True
+
+        ident = c_name(name)
+        etag = fnv1a(data)
+        ctype = CONTENT_TYPES.get(os.path.splitext(name)[1].lower(), "application/octet-stream")
+
+        out.append("// %s, %d bytes%s" % (name, len(data),
+                                          ", gzip" if zipped else ", template" if template else ""))
+        out.append("static const uint8_t assetData_%s[] PROGMEM = {" % ident)
+        for i in range(0, len(data), 16):
+            out.append("    " + " ".join("0x%02x," % b for b in bytearray(data[i:i + 16])))
+        out.append("};")
+        out.append('static const char assetType_%s[] PROGMEM = "Content-Type: %s";' % (ident, ctype))
+        out.append('static const char assetEtag_%s[] PROGMEM = "ETag: \\"%08x\\"";' % (ident, etag))
+        out.append("")
+        total += len(data)
+
+        entry = "assetType_%s, assetEtag_%s, 0x%08xUL, assetData_%s, %d, %s, %s" % (
+            ident, ident, etag, ident, len(data), "true" if zipped else "false",
+            "true" if template else "false")
+        routes.append((name, entry))
+        if name.upper() == INDEX:
+            routes.append(("", entry))
+
+    for i, (path, entry) in enumerate(routes):
+        out.append('static const char assetPath_%d[] PROGMEM = "%s";' % (i, path))
+    out.append("")
+    out.append("#define WEB_ASSET_COUNT %d" % len(routes))
+    out.append("")
+    out.append("static const WebAsset webAssets[] PROGMEM = {")
+    for i, (path, entry) in enumerate(routes):
+        out.append("    { assetPath_%d, %s }," % (i, entry))
+    if not routes:
+        out.append("    { NULL, NULL, NULL, 0, NULL, 0, false, false }")
+    out.append("};")
+    out.append("")
+
+    text = "\n".join(out)
+    path = os.path.join(root, "src", "WebAssetData.h")
+    old = None
+    if os.path.exists(path):
+        with open(path) as f:
+            old = f.read()
+    if text != old:
+        with open(path, "w") as f:
+            f.write(text)
+    print("webassets: %d files, %d bytes of flash" % (len(names), total))
+
+
+try:
+    Import("env")  # noqa: F821, defined when PlatformIO runs us
+    generate(env.subst("$PROJECT_DIR"),  # noqa: F821
+             env.GetProjectOption("custom_webassets_gzip", "yes").lower() in ("yes", "true", "1"))  # noqa: F821
+except NameError:
+    if __name__ == "__main__":
+        generate(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "--no-gzip" not in sys.argv)